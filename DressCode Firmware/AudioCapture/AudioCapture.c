@@ -0,0 +1,209 @@
+/*
+    AudioCapture.c
+    Author: agent
+
+    Streams the raw (pre-filter) ADC values as IMA-ADPCM over UART 2.  The ADC
+    ISR writes each 12-bit sample to a FIFO using AudioCapturePut() and
+    AudioCaptureTasks() encodes the samples to 4 bits per sample in the main
+    loop.
+
+    12-bit samples are converted to signed 16-bit before encoding so that a
+    standard IMA-ADPCM decoder produces 16-bit PCM directly.
+
+    Each frame of AUDIO_CAPTURE_SAMPLES samples is sent as a packet of type
+    PACKET_TYPE_AUDIO_CAPTURE (see Packet.c) with the payload:
+
+    Byte    Description
+    0       sequence number (incremented for each frame sent)
+    1-2     samples lost before first sample (unsigned 16-bit, little-endian)
+    3-4     predictor before first sample (signed 16-bit, little-endian)
+    5       step index before first sample
+    6..37   64 4-bit codes, first sample in the low nibble of each byte
+
+    Each frame carries the encoder state so the decoder can resynchronise after
+    lost samples.  A frame is dropped if the UART TX buffer does not have room
+    for the packet.  If the FIFO overruns then the partial frame and all
+    samples in the FIFO are discarded.  The number of samples lost since the
+    previous frame was sent, saturating at 65535, is sent in the next frame so
+    that the decoder can keep the output time aligned.  Frames lost after they
+    were sent are indicated by gaps in the sequence number.  At 4.032 kHz, the
+    stream requires 2.6 kB/s.
+*/
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include "AudioCapture.h"
+#include "Packet/Packet.h"
+#include "Uart/Uart2.h"
+
+//------------------------------------------------------------------------------
+// Definitions
+
+#define AUDIO_CAPTURE_SAMPLES   64  // samples per frame
+#define HEADER_LENGTH           6
+#define PAYLOAD_LENGTH          (HEADER_LENGTH + (AUDIO_CAPTURE_SAMPLES / 2))
+
+//------------------------------------------------------------------------------
+// Variables
+
+volatile int audioCaptureEnabled = 0;
+volatile unsigned int audioCaptureBuf[AUDIO_CAPTURE_BUF_SIZE];
+volatile unsigned char audioCaptureBufIn = 0;
+static unsigned char audioCaptureBufOut = 0;
+static int predictor;
+static int stepIndex;
+static int framePredictor;
+static int frameStepIndex;
+static unsigned char frame[AUDIO_CAPTURE_SAMPLES / 2];
+static unsigned char sampleCount;
+static unsigned char sequence = 0;
+static unsigned int lostSamples;
+static const int stepTable[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41,
+    45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209,
+    230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876,
+    963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+    3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493,
+    10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086,
+    29794, 32767
+};
+static const int indexTable[8] = { -1, -1, -1, -1, 2, 4, 6, 8 };
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+static unsigned char encode(const int sample);
+static void sendFrame(void);
+static void addLostSamples(const unsigned int count);
+
+//------------------------------------------------------------------------------
+// Functions
+
+void AudioCaptureStart(void) {
+    audioCaptureEnabled = 0;
+    predictor = 0;
+    stepIndex = 0;
+    sampleCount = 0;
+    lostSamples = 0;
+    audioCaptureBufOut = audioCaptureBufIn;
+    audioCaptureEnabled = 1;
+}
+
+void AudioCaptureStop(void) {
+    audioCaptureEnabled = 0;
+}
+
+void AudioCaptureTasks(void) {
+    while(audioCaptureBufOut != audioCaptureBufIn) {
+
+        // Discard frame if FIFO overrun
+        if((unsigned char)(audioCaptureBufIn - audioCaptureBufOut) > AUDIO_CAPTURE_BUF_SIZE) {
+            addLostSamples(sampleCount + (unsigned char)(audioCaptureBufIn - audioCaptureBufOut));
+            audioCaptureBufOut = audioCaptureBufIn;
+            sampleCount = 0;
+            Uart2TxDropped(PAYLOAD_LENGTH + PACKET_OVERHEAD);
+            return;
+        }
+
+        // Store encoder state at start of frame
+        if(sampleCount == 0) {
+            framePredictor = predictor;
+            frameStepIndex = stepIndex;
+        }
+
+        // Encode sample
+        int sample = (int)((audioCaptureBuf[audioCaptureBufOut & (AUDIO_CAPTURE_BUF_SIZE - 1)] << 4) ^ 0x8000);   // offset binary to signed 16-bit
+        audioCaptureBufOut++;
+        unsigned char code = encode(sample);
+        if(sampleCount & 1) {
+            frame[sampleCount >> 1] |= code << 4;
+        }
+        else {
+            frame[sampleCount >> 1] = code;
+        }
+
+        // Send frame when complete
+        if(++sampleCount == AUDIO_CAPTURE_SAMPLES) {
+            sendFrame();
+            sampleCount = 0;
+        }
+    }
+}
+
+static unsigned char encode(const int sample) {
+    long diff = (long)sample - (long)predictor;
+    int step = stepTable[stepIndex];
+    int vpdiff = step >> 3;
+    unsigned char code = 0;
+
+    // Quantise difference
+    if(diff < 0) {
+        code = 8;
+        diff = -diff;
+    }
+    if(diff >= step) {
+        code |= 4;
+        diff -= step;
+        vpdiff += step;
+    }
+    step >>= 1;
+    if(diff >= step) {
+        code |= 2;
+        diff -= step;
+        vpdiff += step;
+    }
+    step >>= 1;
+    if(diff >= step) {
+        code |= 1;
+        vpdiff += step;
+    }
+
+    // Update predictor as the decoder will
+    long newPredictor = code & 8 ? (long)predictor - vpdiff : (long)predictor + vpdiff;
+    if(newPredictor > 32767) {
+        newPredictor = 32767;
+    }
+    else if(newPredictor < -32768) {
+        newPredictor = -32768;
+    }
+    predictor = (int)newPredictor;
+
+    // Update step index
+    stepIndex += indexTable[code & 7];
+    if(stepIndex < 0) {
+        stepIndex = 0;
+    }
+    else if(stepIndex > 88) {
+        stepIndex = 88;
+    }
+    return code;
+}
+
+static void sendFrame(void) {
+    int i;
+    if(!PacketIsPutReady(PAYLOAD_LENGTH)) {
+        addLostSamples(AUDIO_CAPTURE_SAMPLES);
+        Uart2TxDropped(PAYLOAD_LENGTH + PACKET_OVERHEAD);
+        return; // drop frame
+    }
+    PacketBegin(PACKET_TYPE_AUDIO_CAPTURE, PAYLOAD_LENGTH);
+    PacketPut(sequence++);
+    PacketPut((unsigned char)lostSamples);
+    PacketPut((unsigned char)(lostSamples >> 8));
+    PacketPut((unsigned char)framePredictor);
+    PacketPut((unsigned char)(framePredictor >> 8));
+    PacketPut((unsigned char)frameStepIndex);
+    for(i = 0; i < (AUDIO_CAPTURE_SAMPLES / 2); i++) {
+        PacketPut(frame[i]);
+    }
+    PacketEnd();
+    lostSamples = 0;
+}
+
+static void addLostSamples(const unsigned int count) {
+    lostSamples = count < (0xFFFF - lostSamples) ? lostSamples + count : 0xFFFF;
+}
+
+//------------------------------------------------------------------------------
+// End of file
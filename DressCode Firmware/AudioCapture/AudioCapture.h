@@ -0,0 +1,42 @@
+/*
+    AudioCapture.h
+    Author: agent
+*/
+
+#ifndef AudioCapture_h
+#define AudioCapture_h
+
+//------------------------------------------------------------------------------
+// Definitions
+
+#define AUDIO_CAPTURE_BUF_SIZE  32  // must be a power of 2 and less than 256
+
+//------------------------------------------------------------------------------
+// Variable declarations
+
+extern volatile int audioCaptureEnabled;
+extern volatile unsigned int audioCaptureBuf[AUDIO_CAPTURE_BUF_SIZE];
+extern volatile unsigned char audioCaptureBufIn;
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+void AudioCaptureStart(void);
+void AudioCaptureStop(void);
+void AudioCaptureTasks(void);
+
+//------------------------------------------------------------------------------
+// Macros
+
+#define AudioCaptureIsEnabled() (audioCaptureEnabled)
+#define AudioCapturePut(adc) {                                                  \
+    if(audioCaptureEnabled) {                                                   \
+        audioCaptureBuf[audioCaptureBufIn & (AUDIO_CAPTURE_BUF_SIZE - 1)] = adc;\
+        audioCaptureBufIn++;                                                    \
+    }                                                                           \
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+// End of file
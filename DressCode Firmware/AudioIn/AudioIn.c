@@ -17,42 +17,78 @@
     the auto gain to decrease.  An optimal value is as high as possible to
     maximise resolution and preamp gain.  The ideal value is therefore half of
     ADC range because this is highest valid base 2 value.
+
+    The auto gain is limited to MAX_GAIN (preamp GAIN_1024 and a software gain
+    of 4).  The input is silent while the gain is at MAX_GAIN, i.e. the
+    envelope is below P2P_TARGET even at maximum gain, or while the envelope
+    of the ADC value before the software gain (the raw envelope) is below
+    SILENCE_FLOOR.  SILENCE_FLOOR is specified at GAIN_1024 and scaled by the
+    preamp gain so that it is a fixed input level, the level at which the auto
+    gain would settle at MAX_GAIN.  The raw envelope detects the end of music
+    immediately whereas the gain takes several seconds to reach MAX_GAIN.  The auto gain amplifies the noise of a silent input to
+    near P2P_TARGET so AudioInIsSilent() lets Leds.c ignore it.  MAX_GAIN and
+    SILENCE_FLOOR must be high enough that the preamp noise is silent.
+
+    If BATTERY_MONITOR is 1 (see Battery.h) then the battery voltage is
+    measured once every BATTERY_PERIOD interrupts by
+    setting ALTS so that the odd samples of the next sequence are converted
+    from MUX B (BATTERY_CHANNEL).  The audio sample for that sequence is the
+    mean of the 8 even samples.
+
+    The next sequence starts converting (from MUX A) as soon as the interrupt
+    is raised and each conversion takes 62 TCY (31 TAD).  ALTS is therefore
+    set or cleared at the very start of the ISR, before the second conversion
+    of the sequence starts, so that every sequence is either entirely audio or
+    entirely alternating.  This assumes an interrupt latency plus context save
+    of less than 62 TCY, which requires the ADC interrupt to remain the
+    highest priority and not be disabled for longer than a few instructions.
+    The value of ALTS read at the start of the ISR is the setting used for the
+    whole of the sequence just completed.
+
+    The trace is frozen if the preamp gain changes more than CHATTER_SWITCHES
+    times within CHATTER_PERIOD interrupts.
 */
 
 //------------------------------------------------------------------------------
 // Includes
 
+#include "AudioCapture/AudioCapture.h"
 #include "AudioIn.h"
+#include "Battery/Battery.h"
 #include "Fixed.h"
+#include "Latency/Latency.h"
 #include <p24Fxxxx.h>
+#include "Trace/Trace.h"
 
 //------------------------------------------------------------------------------
 // Definitions
 
-typedef enum {
-    GAIN_1,
-    GAIN_4,
-    GAIN_16,
-    GAIN_25,
-    GAIN_64,
-    GAIN_100,
-    GAIN_256,
-    GAIN_1024,
-    INVALID
-} PreampGain;
-
 #define CS_PIN          _LATA9
 #define TWO_PI_T        (6.283185f * (1.0f / 4032.0f))  // 2 * PI * sample period
 #define HP_FILTER_FREQ  7.32f   // Hz
 #define ENVELOPE_FREQ   7.32f   // Hz
 #define AUTO_GAIN_FREQ  0.05f   // Hz
 #define P2P_TARGET      1024    // auto gain peak-to-peak target
+#define MAX_GAIN        2048    // preamp GAIN_1024 with software gain of 4
+#define SILENCE_FLOOR   256     // raw envelope (ADC LSB at GAIN_1024) below which input is silent, P2P_TARGET / 4
+#define BATTERY_PERIOD  1008    // interrupts per battery measurement, 4 Hz
+#define CHATTER_SWITCHES 8      // preamp gain changes per CHATTER_PERIOD considered anomalous
+#define CHATTER_PERIOD  4032    // interrupts, 1 second
 
 //------------------------------------------------------------------------------
 // Variables
 
 static int isGetReady = 0;
 static Fixed sampleValue;
+static unsigned int adcValue;
+static Fixed bias = FIXED_FROM_FLOAT(2048.0f);
+static Fixed envelope = 0;
+static Fixed rawEnvelope = 0;
+static Fixed gain = FIXED_FROM_FLOAT(1.0f / 2048.0f);
+static Fixed swGain = FIXED_FROM_INT(1);
+static PreampGain currentPreampGain = GAIN_INVALID;
+static Fixed silenceFloor = FIXED_FROM_INT(SILENCE_FLOOR) >> 10;
+static int isSilent = 1;
 
 //------------------------------------------------------------------------------
 // Function declarations
@@ -73,6 +109,9 @@ void AudioInInit(void) {
     AD1CON3bits.SAMC = 17;      // Auto-Sample Time = 17 TAD
     AD1CON3bits.ADCS = 1;       // 2 * TCY = TAD
     AD1CHSbits.CH0SA = 1;       // Sample A Channel 0 Positive Input = AN1
+#if BATTERY_MONITOR
+    AD1CHSbits.CH0SB = BATTERY_CHANNEL; // Sample B Channel 0 Positive Input = battery
+#endif
     _AD1IP = 7;                 // set interrupt priority
     _AD1IF = 0;                 // clear interrupt flag
     _AD1IE = 1;                 // enable interrupt
@@ -100,39 +139,113 @@ Fixed AudioInGet(void) {
     return sampleValue;
 }
 
+int AudioInIsSilent(void) {
+    return isSilent;
+}
+
+void AudioInGetStatus(AudioInStatus* const audioInStatus) {
+    _AD1IE = 0; // disable interrupt so that values are coherent
+    audioInStatus->adc = adcValue;
+    audioInStatus->bias = bias;
+    audioInStatus->envelope = envelope;
+    audioInStatus->gain = gain;
+    audioInStatus->swGain = swGain;
+    audioInStatus->preampGain = currentPreampGain;
+    _AD1IE = 1;
+}
+
 //------------------------------------------------------------------------------
 // Functions - ISRs
 
 void __attribute__((interrupt, auto_psv))_ADC1Interrupt(void) {
     unsigned int adc;
-    static Fixed bias = FIXED_FROM_FLOAT(2048.0f);
-    static Fixed envelope = 0;
-    static Fixed gain = FIXED_FROM_FLOAT(1.0f / 2048.0f);
-    static Fixed swGain = FIXED_FROM_INT(1);
+    int isBatterySequence;
+    PreampGain previousPreampGain;
+#if BATTERY_MONITOR
+    static unsigned int batteryTimer = 0;
+#endif
+    static unsigned int chatterTimer = 0;
+    static unsigned int chatterCount = 0;
+
+    // Select inputs for sequence now converting, must be first (see above)
+#if BATTERY_MONITOR
+    isBatterySequence = AD1CON2bits.ALTS;
+    if(++batteryTimer >= BATTERY_PERIOD) {
+        batteryTimer = 0;
+        AD1CON2bits.ALTS = 1;   // interleave battery measurement
+    }
+    else {
+        AD1CON2bits.ALTS = 0;
+    }
+#else
+    isBatterySequence = 0;
+#endif
+
+    TraceIsr(TRACE_EVENT_ADC_ISR_ENTRY, 0);
+    previousPreampGain = currentPreampGain;
 
     // Get ADC result
-    adc = ADC1BUF0;
-    adc += ADC1BUF1;
-    adc += ADC1BUF2;
-    adc += ADC1BUF3;
-    adc += ADC1BUF4;
-    adc += ADC1BUF5;
-    adc += ADC1BUF6;
-    adc += ADC1BUF7;
-    adc += ADC1BUF8;
-    adc += ADC1BUF9;
-    adc += ADC1BUF10;
-    adc += ADC1BUF11;
-    adc += ADC1BUF12;
-    adc += ADC1BUF13;
-    adc += ADC1BUF14;
-    adc += ADC1BUF15;
-    adc >>= 4;     // divide by 16
+    if(isBatterySequence) {
+
+        // Even samples are audio
+        adc = ADC1BUF0;
+        adc += ADC1BUF2;
+        adc += ADC1BUF4;
+        adc += ADC1BUF6;
+        adc += ADC1BUF8;
+        adc += ADC1BUF10;
+        adc += ADC1BUF12;
+        adc += ADC1BUF14;
+        adc >>= 3;     // divide by 8
+
+        // Odd samples are battery
+        unsigned int battery = ADC1BUF1;
+        battery += ADC1BUF3;
+        battery += ADC1BUF5;
+        battery += ADC1BUF7;
+        battery += ADC1BUF9;
+        battery += ADC1BUF11;
+        battery += ADC1BUF13;
+        battery += ADC1BUF15;
+        BatteryPut(battery >> 3);
+    }
+    else {
+        adc = ADC1BUF0;
+        adc += ADC1BUF1;
+        adc += ADC1BUF2;
+        adc += ADC1BUF3;
+        adc += ADC1BUF4;
+        adc += ADC1BUF5;
+        adc += ADC1BUF6;
+        adc += ADC1BUF7;
+        adc += ADC1BUF8;
+        adc += ADC1BUF9;
+        adc += ADC1BUF10;
+        adc += ADC1BUF11;
+        adc += ADC1BUF12;
+        adc += ADC1BUF13;
+        adc += ADC1BUF14;
+        adc += ADC1BUF15;
+        adc >>= 4;     // divide by 16
+    }
+    adcValue = adc;
+
+    // Raw audio capture and latency measurement
+    AudioCapturePut(adc);
+    LatencyAdcPut(adc, FIXED_TO_INT(bias));
 
     // High-pass filter
     Fixed signal = FIXED_FROM_INT(adc) - bias;
     bias += FIXED_MUL(signal, FIXED_FROM_FLOAT(HP_FILTER_FREQ * TWO_PI_T));
 
+    // Raw envelope follower for silence detection
+    if(signal > rawEnvelope) {
+        if(signal > 0) {
+            rawEnvelope = signal;
+        }
+    }
+    rawEnvelope -= FIXED_MUL(rawEnvelope, FIXED_FROM_FLOAT(ENVELOPE_FREQ * TWO_PI_T));
+
     // Apply auto gain
     signal = FIXED_MUL(signal, swGain);
     sampleValue = signal;
@@ -148,39 +261,61 @@ void __attribute__((interrupt, auto_psv))_ADC1Interrupt(void) {
     // Adjust auto gain
     Fixed error = envelope - FIXED_FROM_INT(P2P_TARGET);
     gain -= FIXED_MUL(error, FIXED_FROM_FLOAT(AUTO_GAIN_FREQ * TWO_PI_T));  // proportional feedback
+    if(gain > FIXED_FROM_INT(MAX_GAIN)) {
+        gain = FIXED_FROM_INT(MAX_GAIN);
+    }
 
     // Apply gain as combination of preamp gain and software gain
     if(gain >= FIXED_FROM_INT(1024)) {
         setPreampGain(GAIN_1024);
         swGain = gain >> 9;     // should be 10 but 9 provides correct behaviour when tested, I don't know why
+        silenceFloor = FIXED_FROM_INT(SILENCE_FLOOR);
     }
     else if(gain >= FIXED_FROM_INT(256)) {
         setPreampGain(GAIN_256);
         swGain = gain >> 8;
+        silenceFloor = FIXED_FROM_INT(SILENCE_FLOOR) >> 2;
     }
     else if(gain >= FIXED_FROM_INT(64)) {
         setPreampGain(GAIN_64);
         swGain = gain >> 6;
+        silenceFloor = FIXED_FROM_INT(SILENCE_FLOOR) >> 4;
     }
     else if(gain >= FIXED_FROM_INT(16)) {
         setPreampGain(GAIN_16);
         swGain = gain >> 4;
+        silenceFloor = FIXED_FROM_INT(SILENCE_FLOOR) >> 6;
     }
     else if(gain >= FIXED_FROM_INT(4)) {
         setPreampGain(GAIN_4);
         swGain = gain >> 2;
+        silenceFloor = FIXED_FROM_INT(SILENCE_FLOOR) >> 8;
     }
     else {
         setPreampGain(GAIN_1);
         swGain = FIXED_FROM_INT(1);
+        silenceFloor = FIXED_FROM_INT(SILENCE_FLOOR) >> 10;
+    }
+    isSilent = (gain >= FIXED_FROM_INT(MAX_GAIN)) || (rawEnvelope < silenceFloor);
+
+    // Trace preamp gain changes and freeze trace if gain chatters
+    if(currentPreampGain != previousPreampGain) {
+        TraceIsr(TRACE_EVENT_PREAMP_GAIN, currentPreampGain);
+        if(++chatterCount > CHATTER_SWITCHES) {
+            TraceFreezeNow(TRACE_FREEZE_GAIN_CHATTER);
+        }
+    }
+    if(++chatterTimer >= CHATTER_PERIOD) {
+        chatterTimer = 0;
+        chatterCount = 0;
     }
 
     isGetReady = 1; // set 'data ready' flag
     _AD1IF = 0;     // clear interrupt flag
+    TraceIsr(TRACE_EVENT_ADC_ISR_EXIT, 0);
 }
 
 static void setPreampGain(const PreampGain preampGain) {
-    static PreampGain currentPreampGain = INVALID;
     if(preampGain != currentPreampGain) {
         currentPreampGain = preampGain;
         CS_PIN = 0;         // assert chip select
@@ -188,7 +323,7 @@ static void setPreampGain(const PreampGain preampGain) {
         SPI2BUF = 0x4000 | preampGain;
         while(!_SPI2IF);    // wait for transmit to complete
         CS_PIN = 1;         // chip select idle
-        asm volatile("MOV SPI2BUF, W0");    // discard received data
+        (void)SPI2BUF;      // discard received data
     }
 }
 
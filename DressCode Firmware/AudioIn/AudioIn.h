@@ -11,12 +11,38 @@
 
 #include "Fixed.h"
 
+//------------------------------------------------------------------------------
+// Definitions
+
+typedef enum {
+    GAIN_1,
+    GAIN_4,
+    GAIN_16,
+    GAIN_25,
+    GAIN_64,
+    GAIN_100,
+    GAIN_256,
+    GAIN_1024,
+    GAIN_INVALID
+} PreampGain;
+
+typedef struct {
+    unsigned int adc;   // mean of 16 ADC samples
+    Fixed bias;
+    Fixed envelope;
+    Fixed gain;
+    Fixed swGain;
+    PreampGain preampGain;
+} AudioInStatus;
+
 //------------------------------------------------------------------------------
 // Function declarations
 
 void AudioInInit(void);
 int AudioInIsGetReady(void);
 Fixed AudioInGet(void);
+int AudioInIsSilent(void);
+void AudioInGetStatus(AudioInStatus* const audioInStatus);
 
 #endif
 
@@ -0,0 +1,163 @@
+/*
+    Battery.c
+    Author: agent
+
+    The battery voltage is measured by the ADC ISR (see AudioIn.c) at 4 Hz on
+    BATTERY_CHANNEL through a resistor divider of DIVIDER_RATIO.
+
+    BATTERY_MONITOR must only be set to 1 once the divider, DIVIDER_RATIO and
+    VREF have been confirmed against the PCB.  A floating or misscaled input
+    would select BATTERY_TIER_CRITICAL and dim the LEDs.  If BATTERY_MONITOR is
+    0 then the voltage is not measured, BatteryGetMillivolts() returns 0, the
+    tier is always BATTERY_TIER_FULL and the runtime is always
+    BATTERY_RUNTIME_UNKNOWN.  Only the charging status is monitored.
+
+    The performance tier is selected from the filtered voltage with
+    TIER_HYSTERESIS to prevent the tier chattering as the voltage recovers
+    under reduced load.  The tier is always BATTERY_TIER_FULL while charging.
+
+    The remaining runtime is estimated every RUNTIME_PERIOD from the decrease
+    in state of charge, which is interpolated from a typical LiPo discharge
+    curve.  The runtime is BATTERY_RUNTIME_UNKNOWN until the first decrease is
+    observed or while charging.
+*/
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include "Battery.h"
+#include "Trace/Trace.h"
+
+//------------------------------------------------------------------------------
+// Definitions
+
+#define VREF            2.048f  // external VREF+ (V)
+#define DIVIDER_RATIO   3.0f    // battery voltage / BATTERY_CHANNEL voltage
+#define MV_SCALE        (unsigned int)(VREF * DIVIDER_RATIO * 1000.0f)  // mV per ADC full scale
+#define FILTER_SHIFT    3       // filter time constant of 8 measurements (2 s)
+#define TIER_HYSTERESIS 50      // mV
+#define RUNTIME_PERIOD  1200    // measurements, 5 minutes
+#define RUNTIME_MINUTES 5       // minutes per RUNTIME_PERIOD
+#define SOC_POINTS      8
+
+//------------------------------------------------------------------------------
+// Variables
+
+volatile unsigned int batteryAdc;
+volatile int batteryIsAdcReady = 0;
+static unsigned long millivoltsSum = 0;    // filtered millivolts << FILTER_SHIFT
+static BatteryTier tier = BATTERY_TIER_FULL;
+static int wasCharging = 0;
+static unsigned int runtimeTimer = 0;
+static int previousSoc = -1;
+static int socDropRate = 0;                 // per mille per RUNTIME_PERIOD << 4
+static unsigned int runtime = BATTERY_RUNTIME_UNKNOWN;
+static const unsigned int tierThresholds[3] = { 3800, 3650, 3500 };    // mV, lower limit of FULL, REDUCED and ECONOMY
+static const unsigned int socMillivolts[SOC_POINTS] = { 4200, 4000, 3900, 3800, 3700, 3600, 3500, 3300 };
+static const int socPerMille[SOC_POINTS] = { 1000, 800, 650, 500, 300, 150, 50, 0 };
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+static int stateOfCharge(const unsigned int millivolts);
+static void updateRuntime(const unsigned int millivolts);
+
+//------------------------------------------------------------------------------
+// Functions
+
+void BatteryUpdate(void) {
+    unsigned int millivolts;
+    int i;
+
+    // Trace charging state changes
+    if(BatteryIsCharging() != wasCharging) {
+        wasCharging = BatteryIsCharging();
+        TraceMain(TRACE_EVENT_CHARGING, wasCharging);
+    }
+
+    if(!batteryIsAdcReady) {
+        return;
+    }
+    batteryIsAdcReady = 0;
+
+    // Filter voltage
+    millivolts = (unsigned int)(((unsigned long)batteryAdc * MV_SCALE) >> 12);
+    if(millivoltsSum == 0) {
+        millivoltsSum = (unsigned long)millivolts << FILTER_SHIFT;
+    }
+    millivoltsSum += millivolts - (millivoltsSum >> FILTER_SHIFT);
+    millivolts = BatteryGetMillivolts();
+
+    // Select tier
+    BatteryTier newTier = BATTERY_TIER_FULL;
+    if(!wasCharging) {
+        newTier = BATTERY_TIER_CRITICAL;
+        for(i = 0; i < 3; i++) {
+            unsigned int threshold = tierThresholds[i];
+            if(i < tier) {
+                threshold += TIER_HYSTERESIS;   // require higher voltage to return to a higher tier
+            }
+            if(millivolts >= threshold) {
+                newTier = i;
+                break;
+            }
+        }
+    }
+    if(newTier != tier) {
+        tier = newTier;
+        TraceMain(TRACE_EVENT_BATTERY_TIER, tier);
+    }
+
+    // Estimate remaining runtime
+    if(++runtimeTimer >= RUNTIME_PERIOD) {
+        runtimeTimer = 0;
+        updateRuntime(millivolts);
+    }
+}
+
+unsigned int BatteryGetMillivolts(void) {
+    return (unsigned int)(millivoltsSum >> FILTER_SHIFT);
+}
+
+BatteryTier BatteryGetTier(void) {
+    return tier;
+}
+
+unsigned int BatteryGetRuntime(void) {
+    return runtime;
+}
+
+static int stateOfCharge(const unsigned int millivolts) {
+    int i;
+    if(millivolts >= socMillivolts[0]) {
+        return socPerMille[0];
+    }
+    for(i = 1; i < SOC_POINTS; i++) {
+        if(millivolts >= socMillivolts[i]) {
+            return socPerMille[i] + (int)(((long)(millivolts - socMillivolts[i]) * (socPerMille[i - 1] - socPerMille[i])) / (int)(socMillivolts[i - 1] - socMillivolts[i]));
+        }
+    }
+    return 0;
+}
+
+static void updateRuntime(const unsigned int millivolts) {
+    int soc = stateOfCharge(millivolts);
+    if(BatteryIsCharging()) {
+        previousSoc = -1;
+        socDropRate = 0;
+        runtime = BATTERY_RUNTIME_UNKNOWN;
+        return;
+    }
+    if(previousSoc >= 0) {
+        int drop = (previousSoc - soc) * 16;
+        socDropRate = socDropRate == 0 ? drop : socDropRate + ((drop - socDropRate) >> 2);
+    }
+    previousSoc = soc;
+    if(socDropRate > 0) {
+        unsigned long minutes = ((unsigned long)soc * RUNTIME_MINUTES << 4) / socDropRate;
+        runtime = minutes < BATTERY_RUNTIME_UNKNOWN ? (unsigned int)minutes : BATTERY_RUNTIME_UNKNOWN - 1;
+    }
+}
+
+//------------------------------------------------------------------------------
+// End of file
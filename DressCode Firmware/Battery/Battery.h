@@ -0,0 +1,52 @@
+/*
+    Battery.h
+    Author: agent
+*/
+
+#ifndef Battery_h
+#define Battery_h
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include <p24Fxxxx.h>
+
+//------------------------------------------------------------------------------
+// Definitions
+
+typedef enum {
+    BATTERY_TIER_FULL,
+    BATTERY_TIER_REDUCED,
+    BATTERY_TIER_ECONOMY,
+    BATTERY_TIER_CRITICAL
+} BatteryTier;
+
+#define BATTERY_MONITOR     0       // 1 if the battery divider is fitted to BATTERY_CHANNEL, see Battery.c
+#define BATT_STAT           _RC0    // battery charging status (active low)
+#define BATTERY_CHANNEL     12      // AN12 (RB12), battery voltage via divider
+#define BATTERY_RUNTIME_UNKNOWN 0xFFFF
+
+//------------------------------------------------------------------------------
+// Variable declarations
+
+extern volatile unsigned int batteryAdc;
+extern volatile int batteryIsAdcReady;
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+void BatteryUpdate(void);
+unsigned int BatteryGetMillivolts(void);
+BatteryTier BatteryGetTier(void);
+unsigned int BatteryGetRuntime(void);
+
+//------------------------------------------------------------------------------
+// Macros
+
+#define BatteryIsCharging() (!BATT_STAT)
+#define BatteryPut(adc) { batteryAdc = adc; batteryIsAdcReady = 1; }
+
+#endif
+
+//------------------------------------------------------------------------------
+// End of file
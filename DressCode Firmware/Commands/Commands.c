@@ -0,0 +1,124 @@
+/*
+    Commands.c
+    Author: agent
+
+    Parses the commands received on UART 2.  CommandsProcess() is called once
+    per audio sample by the main loop and also by the host test harnesses
+    (see Host/SyncPty) so that they exercise this parser.  A command is left in
+    the RX buffer until all of its argument bytes have been received.
+
+    Command             Description
+    'C'                 start raw audio capture (IMA-ADPCM packets)
+    'c'                 stop raw audio capture
+    'T' <ch> <dl> <dh>  set telemetry channel to 16-bit decimation (0 = off),
+                        acknowledged by a status packet (see Telemetry.c)
+    't'                 disable all telemetry channels, acknowledged likewise
+    'S' <mode>          set sync mode (0 = off, 1 = leader, 2 = follower)
+    'L'                 measure sound to light latency
+    'D'                 freeze and dump trace
+    'R'                 clear trace and resume recording
+    'E' <ml> <mh>       set 16-bit mask of trace events recorded
+    0x7E                packet (see Packet.c), sync packets from the leader
+
+    Unknown bytes are discarded.  A device becomes a follower when it receives
+    a sync packet (see Sync.c).  Commands other than packets are ignored while
+    following because the RX is wired to the leader's TX and any other byte is
+    noise.
+*/
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include "AudioCapture/AudioCapture.h"
+#include "Commands.h"
+#include "Latency/Latency.h"
+#include "Packet/Packet.h"
+#include "Sync/Sync.h"
+#include "Telemetry/Telemetry.h"
+#include "Trace/Trace.h"
+#include "Uart/Uart2.h"
+
+//------------------------------------------------------------------------------
+// Functions
+
+void CommandsProcess(void) {
+    unsigned char channel;
+    unsigned int decimation;
+    unsigned int events;
+    PacketType packetType;
+    unsigned char payload[SYNC_PAYLOAD_LENGTH];
+    int length;
+    while(Uart2IsGetReady()) {
+        if((SyncGetMode() == SYNC_MODE_FOLLOWER) && (uart2RxBuf[uart2RxBufOut] != PACKET_SYNC)) {
+            Uart2GetChar(); // ignore command from leader link
+            continue;
+        }
+        switch(uart2RxBuf[uart2RxBufOut]) {
+            case 'C':
+                Uart2GetChar();
+                AudioCaptureStart();
+                break;
+            case 'c':
+                Uart2GetChar();
+                AudioCaptureStop();
+                break;
+            case 'T':
+                if((unsigned char)Uart2IsGetReady() < 4) {
+                    return; // wait for arguments
+                }
+                Uart2GetChar();
+                channel = Uart2GetChar();
+                decimation = (unsigned char)Uart2GetChar();
+                decimation |= (unsigned int)(unsigned char)Uart2GetChar() << 8;
+                TelemetrySetChannel(channel, decimation);   // result reported by status packet
+                break;
+            case 't':
+                Uart2GetChar();
+                TelemetryDisable();
+                break;
+            case 'L':
+                Uart2GetChar();
+                LatencyStart();
+                break;
+            case 'D':
+                Uart2GetChar();
+                TraceDump();
+                break;
+            case 'R':
+                Uart2GetChar();
+                TraceResume();
+                break;
+            case 'E':
+                if((unsigned char)Uart2IsGetReady() < 3) {
+                    return; // wait for arguments
+                }
+                Uart2GetChar();
+                events = (unsigned char)Uart2GetChar();
+                events |= (unsigned int)(unsigned char)Uart2GetChar() << 8;
+                traceEvents = events;
+                break;
+            case 'S':
+                if((unsigned char)Uart2IsGetReady() < 2) {
+                    return; // wait for argument
+                }
+                Uart2GetChar();
+                SyncSetMode(Uart2GetChar());
+                break;
+            case PACKET_SYNC:
+                length = PacketGet(&packetType, payload, sizeof(payload));
+                if(length == PACKET_GET_INCOMPLETE) {
+                    return; // wait for complete packet
+                }
+                if((length >= 0) && (packetType == PACKET_TYPE_SYNC)) {
+                    SyncReceive(payload, length);
+                }
+                break;
+            default:
+                Uart2GetChar();    // discard unknown command
+                break;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// End of file
@@ -0,0 +1,17 @@
+/*
+    Commands.h
+    Author: agent
+*/
+
+#ifndef Commands_h
+#define Commands_h
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+void CommandsProcess(void);
+
+#endif
+
+//------------------------------------------------------------------------------
+// End of file
@@ -0,0 +1,95 @@
+/*
+    Format.c
+    Author: agent
+
+    Writes decimal ASCII directly to the UART 2 TX buffer without using the
+    div() library function.  Integer digits are extracted by repeated
+    subtraction of powers of 10 (at most 9 subtractions per digit) and
+    fractional digits are extracted by multiplying the Q16 fraction by 10 using
+    shifts.  Fractional digits are truncated, not rounded.
+
+    The caller must ensure Uart2IsPutReady() is at least FORMAT_INT_MAX_LENGTH
+    or FORMAT_FIXED_MAX_LENGTH(fractionDigits).  FormatGetUnsignedLength() and
+    FormatGetIntLength() return the exact number of characters that would be
+    written, e.g. to count the bytes of a value that is not written.
+*/
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include "Fixed.h"
+#include "Format.h"
+#include "Uart/Uart2.h"
+
+//------------------------------------------------------------------------------
+// Variables
+
+static const unsigned int powersOf10[4] = { 10000, 1000, 100, 10 };
+
+//------------------------------------------------------------------------------
+// Functions
+
+void FormatPutUnsigned(unsigned int value) {
+    int i;
+    int print = 0;
+    for(i = 0; i < 4; i++) {
+        char digit = '0';
+        while(value >= powersOf10[i]) {
+            value -= powersOf10[i];
+            digit++;
+        }
+        if(digit != '0' || print) {
+            Uart2PutChar(digit);
+            print = 1;
+        }
+    }
+    Uart2PutChar('0' + value);
+}
+
+void FormatPutInt(const int value) {
+    if(value < 0) {
+        Uart2PutChar('-');
+        FormatPutUnsigned(-(unsigned int)value);
+    }
+    else {
+        FormatPutUnsigned(value);
+    }
+}
+
+int FormatGetUnsignedLength(const unsigned int value) {
+    int i;
+    for(i = 0; i < 4; i++) {
+        if(value >= powersOf10[i]) {
+            break;
+        }
+    }
+    return 5 - i;
+}
+
+int FormatGetIntLength(const int value) {
+    if(value < 0) {
+        return 1 + FormatGetUnsignedLength(-(unsigned int)value);
+    }
+    return FormatGetUnsignedLength(value);
+}
+
+void FormatPutFixed(const Fixed value, int fractionDigits) {
+    unsigned long magnitude = value;
+    if(value < 0) {
+        Uart2PutChar('-');
+        magnitude = -magnitude;
+    }
+    FormatPutUnsigned((unsigned int)(magnitude >> 16));
+    if(fractionDigits > 0) {
+        unsigned long fraction = magnitude & 0xFFFF;
+        Uart2PutChar('.');
+        while(fractionDigits-- > 0) {
+            fraction = (fraction << 3) + (fraction << 1);   // multiply by 10
+            Uart2PutChar('0' + (char)(fraction >> 16));
+            fraction &= 0xFFFF;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+// End of file
@@ -0,0 +1,32 @@
+/*
+    Format.h
+    Author: agent
+*/
+
+#ifndef Format_h
+#define Format_h
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include "Fixed.h"
+
+//------------------------------------------------------------------------------
+// Definitions
+
+#define FORMAT_INT_MAX_LENGTH   6   // "-32768"
+#define FORMAT_FIXED_MAX_LENGTH(fractionDigits) (FORMAT_INT_MAX_LENGTH + 1 + (fractionDigits))
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+void FormatPutUnsigned(unsigned int value);
+void FormatPutInt(const int value);
+void FormatPutFixed(const Fixed value, int fractionDigits);
+int FormatGetUnsignedLength(const unsigned int value);
+int FormatGetIntLength(const int value);
+
+#endif
+
+//------------------------------------------------------------------------------
+// End of file
@@ -0,0 +1,193 @@
+/*
+    Latency.c
+    Author: agent
+
+    Measures the latency from sound to light.  Timer 1 runs at 500 kHz (2 us
+    per tick, 131 ms range) to timestamp each stage of the pipeline.
+    LatencyStart() waits until the mean of each ADC sequence has remained
+    within LATENCY_QUIET_THRESH of the bias for LATENCY_QUIET_SAMPLES and then
+    arms the measurement.  The quiet check uses the ADC rather than the LED
+    triggers so that it does not depend on the silence detection of the auto
+    gain (see AudioIn.c).  The measurement starts when the mean of an ADC
+    sequence deviates from the bias by more than LATENCY_ADC_THRESH (e.g. a
+    clap or an impulse from a speaker).  The LED trigger and render stages are timestamped on the
+    first LED that turns on after the crossing, i.e. a 0 to 1 edge of a trigger
+    bit, so that LEDs already on at the crossing are not mistaken for the
+    response.
+
+    The result is sent as a packet of type PACKET_TYPE_LATENCY (see Packet.c)
+    with the payload:
+
+    Byte    Description
+    0       status (see below)
+    1-2     ADC averaging, half the sequence period (constant)
+    3-4     ADC ISR to main loop
+    5-6     main loop to LED trigger (envelope follower and thresholds)
+    7-8     LED trigger to OC register write (sync delay and rendering)
+    9-10    OC register write to start of next PWM period
+    11-12   total
+
+    Status Description
+    0       successful
+    1       no LED turned on within TIMEOUT_SAMPLES of the crossing
+    2       not quiet within ARM_TIMEOUT_SAMPLES
+    3       no sound within ARM_TIMEOUT_SAMPLES of being armed
+
+    All times are unsigned 16-bit, little-endian, in 2 us ticks, and are zero
+    if the status is not 0.  The PWM stage assumes the LED was off so that the
+    new duty cycle is first output at the start of the next Timer 3 period.
+    If the UART transmit buffer is full then the result is retried each sample
+    for up to SEND_TIMEOUT_SAMPLES before being counted as dropped.
+
+    Host/Latency.py prints the result and simulates the measurement on a PC.
+*/
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include "Latency.h"
+#include "Packet/Packet.h"
+#include <p24Fxxxx.h>
+#include "Uart/Uart2.h"
+
+//------------------------------------------------------------------------------
+// Definitions
+
+#define TIMEOUT_SAMPLES         500     // 124 ms, must be less than Timer 1 range
+#define ARM_TIMEOUT_SAMPLES     40320   // 10 seconds
+#define SEND_TIMEOUT_SAMPLES    4032    // 1 second
+#define AVERAGING_TICKS         62      // 16 conversions * 31 TAD * 0.5 us / 2, in 2 us ticks
+#define PAYLOAD_LENGTH          13
+
+#define STATUS_SUCCESSFUL       0
+#define STATUS_NO_TRIGGER       1
+#define STATUS_NOT_QUIET        2
+#define STATUS_NO_SOUND         3
+
+//------------------------------------------------------------------------------
+// Variables
+
+volatile LatencyState latencyState = LATENCY_STATE_IDLE;
+volatile unsigned int latencyAdcTime;
+volatile unsigned int latencyQuietCount;
+static unsigned int sampleTime;
+static unsigned int detectTime;
+static unsigned int renderTime;
+static unsigned int pwmTicks;
+static unsigned int sampleCounter;
+static int detectedTriggers;
+static int previousDetectTriggers = 0;
+static int previousRenderTriggers = 0;
+static unsigned char status;
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+static void setResult(const unsigned char resultStatus);
+static void sendResult(void);
+static void putInt(const unsigned int value);
+
+//------------------------------------------------------------------------------
+// Functions
+
+void LatencyInit(void) {
+    T1CONbits.TCKPS = 0b01; // 1:8 prescale, 500 kHz at 4 MIPS
+    PR1 = 0xFFFF;
+    T1CONbits.TON = 1;
+}
+
+void LatencyStart(void) {
+    sampleCounter = 0;
+    latencyQuietCount = 0;
+    latencyState = LATENCY_STATE_WAIT_QUIET;
+}
+
+void LatencySample(void) {
+    switch(latencyState) {
+        case LATENCY_STATE_WAIT_QUIET:
+        case LATENCY_STATE_ARMED:
+            if(++sampleCounter >= ARM_TIMEOUT_SAMPLES) {
+                setResult(latencyState == LATENCY_STATE_WAIT_QUIET ? STATUS_NOT_QUIET : STATUS_NO_SOUND);
+            }
+            break;
+        case LATENCY_STATE_CROSSED:
+            sampleTime = TMR1;
+            sampleCounter = 0;
+            latencyState = LATENCY_STATE_WAIT_DETECT;
+            break;
+        case LATENCY_STATE_WAIT_DETECT:
+        case LATENCY_STATE_WAIT_RENDER:
+            if(++sampleCounter >= TIMEOUT_SAMPLES) {
+                setResult(STATUS_NO_TRIGGER);
+            }
+            break;
+        case LATENCY_STATE_SEND:
+            if(PacketIsPutReady(PAYLOAD_LENGTH)) {
+                sendResult();
+                latencyState = LATENCY_STATE_IDLE;
+            }
+            else if(++sampleCounter >= SEND_TIMEOUT_SAMPLES) {
+                Uart2TxDropped(PAYLOAD_LENGTH + PACKET_OVERHEAD);
+                latencyState = LATENCY_STATE_IDLE;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+void LatencyDetect(const int triggers) {
+    int risingTriggers = triggers & ~previousDetectTriggers;
+    previousDetectTriggers = triggers;
+    if((latencyState == LATENCY_STATE_WAIT_DETECT) && (risingTriggers != 0)) {
+        detectTime = TMR1;
+        detectedTriggers = risingTriggers;
+        latencyState = LATENCY_STATE_WAIT_RENDER;
+    }
+}
+
+void LatencyRender(const int triggers) {
+    int risingTriggers = triggers & ~previousRenderTriggers;
+    previousRenderTriggers = triggers;
+    if((latencyState == LATENCY_STATE_WAIT_RENDER) && ((risingTriggers & detectedTriggers) != 0)) {
+        renderTime = TMR1;
+        pwmTicks = (PR3 - TMR3) >> 3;   // Timer 3 runs at 4 MHz
+        setResult(STATUS_SUCCESSFUL);
+    }
+}
+
+static void setResult(const unsigned char resultStatus) {
+    status = resultStatus;
+    sampleCounter = 0;
+    latencyState = LATENCY_STATE_SEND;
+}
+
+static void sendResult(void) {
+    PacketBegin(PACKET_TYPE_LATENCY, PAYLOAD_LENGTH);
+    PacketPut(status);
+    if(status != STATUS_SUCCESSFUL) {
+        putInt(0);
+        putInt(0);
+        putInt(0);
+        putInt(0);
+        putInt(0);
+        putInt(0);
+    }
+    else {
+        putInt(AVERAGING_TICKS);
+        putInt(sampleTime - latencyAdcTime);
+        putInt(detectTime - sampleTime);
+        putInt(renderTime - detectTime);
+        putInt(pwmTicks);
+        putInt(AVERAGING_TICKS + (renderTime - latencyAdcTime) + pwmTicks);
+    }
+    PacketEnd();
+}
+
+static void putInt(const unsigned int value) {
+    PacketPut((unsigned char)value);
+    PacketPut((unsigned char)(value >> 8));
+}
+
+//------------------------------------------------------------------------------
+// End of file
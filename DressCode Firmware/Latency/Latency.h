@@ -0,0 +1,74 @@
+/*
+    Latency.h
+    Author: agent
+*/
+
+#ifndef Latency_h
+#define Latency_h
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include <p24Fxxxx.h>
+
+//------------------------------------------------------------------------------
+// Definitions
+
+typedef enum {
+    LATENCY_STATE_IDLE,
+    LATENCY_STATE_WAIT_QUIET,
+    LATENCY_STATE_ARMED,
+    LATENCY_STATE_CROSSED,
+    LATENCY_STATE_WAIT_DETECT,
+    LATENCY_STATE_WAIT_RENDER,
+    LATENCY_STATE_SEND
+} LatencyState;
+
+#define LATENCY_ADC_THRESH      256     // ADC deviation from bias that starts a measurement
+#define LATENCY_QUIET_THRESH    64      // maximum ADC deviation from bias while waiting for quiet
+#define LATENCY_QUIET_SAMPLES   4032    // 1 second
+
+//------------------------------------------------------------------------------
+// Variable declarations
+
+extern volatile LatencyState latencyState;
+extern volatile unsigned int latencyAdcTime;
+extern volatile unsigned int latencyQuietCount;
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+void LatencyInit(void);
+void LatencyStart(void);
+void LatencySample(void);
+void LatencyDetect(const int triggers);
+void LatencyRender(const int triggers);
+
+//------------------------------------------------------------------------------
+// Macros
+
+#define LatencyAdcPut(adc, biasInt) {                                           \
+    int deviation = (int)(adc) - (biasInt);                                     \
+    if(deviation < 0) {                                                         \
+        deviation = -deviation;                                                 \
+    }                                                                           \
+    if(latencyState == LATENCY_STATE_ARMED) {                                   \
+        if(deviation > LATENCY_ADC_THRESH) {                                    \
+            latencyAdcTime = TMR1;                                              \
+            latencyState = LATENCY_STATE_CROSSED;                               \
+        }                                                                       \
+    }                                                                           \
+    else if(latencyState == LATENCY_STATE_WAIT_QUIET) {                         \
+        if(deviation > LATENCY_QUIET_THRESH) {                                  \
+            latencyQuietCount = 0;                                              \
+        }                                                                       \
+        else if(++latencyQuietCount >= LATENCY_QUIET_SAMPLES) {                 \
+            latencyState = LATENCY_STATE_ARMED;                                 \
+        }                                                                       \
+    }                                                                           \
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+// End of file
@@ -1,11 +1,33 @@
 /*
     Leds.c
     Author: Seb Madgwick
+
+    The peak duty cycle and the LEDs enabled are limited according to the
+    battery tier to extend runtime as the battery drains.  The tier is always
+    BATTERY_TIER_FULL unless BATTERY_MONITOR is 1 (see Battery.h).  The PWM
+    frequency is not reduced because 61 Hz is already close to the limit of
+    visible flicker.
+
+    Each LED threshold tracks a target percentile of the envelope so that the
+    LEDs are equally lively regardless of the loudness of the venue.  Once
+    every FRAME_SAMPLES, each threshold is increased by a fraction
+    QUANTILE_RATE * PERCENTILE of itself if the envelope is above the
+    threshold, else decreased by a fraction QUANTILE_RATE * (1 - PERCENTILE).
+    The threshold settles where the envelope exceeds it for (1 - PERCENTILE)
+    of the time.  The multiplicative steps make the rate of adaptation
+    independent of loudness and the cost is constant per frame.  MIN_THRESH
+    keeps the thresholds positive so that they can recover.
+
+    The auto gain (see AudioIn.c) amplifies noise to near the same level as
+    music so the thresholds alone cannot distinguish silence.  While AudioIn
+    reports silence the thresholds are not adapted, so that they are ready
+    when the music resumes, and no LEDs are triggered.
 */
 
 //------------------------------------------------------------------------------
 // Includes
 
+#include "Battery/Battery.h"
 #include "Fixed.h"
 #include "Leds.h"
 #include <p24Fxxxx.h>
@@ -15,14 +37,43 @@
 
 #define TWO_PI_T        (6.283185f * (1.0f / 4032.0f))  // 2 * PI * sample period
 #define ENVELOPE_FREQ   1.0f    // Hz
-#define LED1_THRESH     3000    // threshold relative to envelope
+#define LED1_THRESH     3000    // initial threshold relative to envelope
 #define LED2_THRESH     2000
 #define LED3_THRESH     1000
+#define LED1_PERCENTILE 0.95f   // target percentile of envelope
+#define LED2_PERCENTILE 0.85f
+#define LED3_PERCENTILE 0.6f
+#define MIN_THRESH      100
+#define FRAME_SAMPLES   64      // samples per threshold update, 63 Hz
+#define QUANTILE_RATE   0.01f   // fraction of threshold per frame
 #define LED1_OFF_RATE   50      // arbitrary units
 #define LED2_OFF_RATE   100
 #define LED3_OFF_RATE   200
 
-#define BATT_STAT       _RC0    // battery charging status (active low)
+//------------------------------------------------------------------------------
+// Variables
+
+static unsigned int led1 = 0;
+static unsigned int led2 = 0;
+static unsigned int led3 = 0;
+static Fixed thresholds[3] = { FIXED_FROM_INT(LED1_THRESH), FIXED_FROM_INT(LED2_THRESH), FIXED_FROM_INT(LED3_THRESH) };
+static const Fixed thresholdUp[3] = {
+    FIXED_FROM_FLOAT(QUANTILE_RATE * LED1_PERCENTILE),
+    FIXED_FROM_FLOAT(QUANTILE_RATE * LED2_PERCENTILE),
+    FIXED_FROM_FLOAT(QUANTILE_RATE * LED3_PERCENTILE)
+};
+static const Fixed thresholdDown[3] = {
+    FIXED_FROM_FLOAT(QUANTILE_RATE * (1.0f - LED1_PERCENTILE)),
+    FIXED_FROM_FLOAT(QUANTILE_RATE * (1.0f - LED2_PERCENTILE)),
+    FIXED_FROM_FLOAT(QUANTILE_RATE * (1.0f - LED3_PERCENTILE))
+};
+static const unsigned int tierPeakDuty[4] = { 65535, 40000, 24000, 8000 };  // indexed by BatteryTier
+static const int tierLeds[4] = {
+    LEDS_LED1 | LEDS_LED2 | LEDS_LED3,
+    LEDS_LED1 | LEDS_LED2 | LEDS_LED3,
+    LEDS_LED1 | LEDS_LED2,
+    LEDS_LED1
+};
 
 //------------------------------------------------------------------------------
 // Functions
@@ -45,38 +96,73 @@ void LedsInit(void) {
     OC3CON2bits.SYNCSEL = 0b01101;
 }
 
-void LedsUpdate(Fixed audioSample) {
-    static unsigned led1 = 0;
-    static unsigned led2 = 0;
-    static unsigned led3 = 0;
+int LedsDetect(const Fixed audioSample, const int isSilent) {
+    static Fixed envelope = 0;
+    static int frameCounter = 0;
+    int triggers = 0;
+    int i;
 
-    if(!BATT_STAT) {    // blink LED to indicate charging
-        static int timer = 0;
-        if(--timer < 0) {
-            led1 = 65535;
-            timer = 4032 + 2016;
+    // Envelope follower
+    if(audioSample > envelope) {
+        if(audioSample > 0) {
+            envelope = audioSample;
         }
     }
-    else {
+    envelope -= FIXED_MUL(envelope, FIXED_FROM_FLOAT(ENVELOPE_FREQ * TWO_PI_T));
 
-        // Envelope follower
-        static Fixed envelope = 0;
-        if(audioSample > envelope) {
-            if(audioSample > 0) {
-                envelope = audioSample;
+    // No LEDs in silence
+    if(isSilent) {
+        return 0;
+    }
+
+    // Adapt thresholds to target percentiles
+    if(++frameCounter >= FRAME_SAMPLES) {
+        frameCounter = 0;
+        for(i = 0; i < 3; i++) {
+            if(envelope > thresholds[i]) {
+                thresholds[i] += FIXED_MUL(thresholds[i], thresholdUp[i]);
+            }
+            else {
+                thresholds[i] -= FIXED_MUL(thresholds[i], thresholdDown[i]);
+                if(thresholds[i] < FIXED_FROM_INT(MIN_THRESH)) {
+                    thresholds[i] = FIXED_FROM_INT(MIN_THRESH);
+                }
             }
         }
-        envelope -= FIXED_MUL(envelope, FIXED_FROM_FLOAT(ENVELOPE_FREQ * TWO_PI_T));
+    }
+
+    // Turn on LEDs according to thresholds
+    if(envelope > thresholds[0]) {
+        triggers |= LEDS_LED1;
+    }
+    if(envelope > thresholds[1]) {
+        triggers |= LEDS_LED2;
+    }
+    if(envelope > thresholds[2]) {
+        triggers |= LEDS_LED3;
+    }
+    return triggers;
+}
 
-        // Turn on LEDs according to thresholds
-        if(envelope > FIXED_FROM_INT(LED1_THRESH)) {
+void LedsRender(const int triggers) {
+    if(BatteryIsCharging()) {   // blink LED to indicate charging
+        static int timer = 0;
+        if(--timer < 0) {
             led1 = 65535;
+            timer = 4032 + 2016;
+        }
+    }
+    else {
+        BatteryTier tier = BatteryGetTier();
+        int enabledTriggers = triggers & tierLeds[tier];
+        if(enabledTriggers & LEDS_LED1) {
+            led1 = tierPeakDuty[tier];
         }
-        if(envelope > FIXED_FROM_INT(LED2_THRESH)) {
-            led2 = 65535;
+        if(enabledTriggers & LEDS_LED2) {
+            led2 = tierPeakDuty[tier];
         }
-        if(envelope > FIXED_FROM_INT(LED3_THRESH)) {
-            led3 = 65535;
+        if(enabledTriggers & LEDS_LED3) {
+            led3 = tierPeakDuty[tier];
         }
     }
 
@@ -91,5 +177,29 @@ void LedsUpdate(Fixed audioSample) {
     OC3R = led3;
 }
 
+unsigned int LedsGetDuty(const int ledNumber) {
+    switch(ledNumber) {
+        case 1:
+            return led1;
+        case 2:
+            return led2;
+        case 3:
+            return led3;
+        default:
+            return 0;
+    }
+}
+
+Fixed LedsGetThreshold(const int ledNumber) {
+    switch(ledNumber) {
+        case 1:
+        case 2:
+        case 3:
+            return thresholds[ledNumber - 1];
+        default:
+            return 0;
+    }
+}
+
 //------------------------------------------------------------------------------
 // End of file
@@ -11,11 +11,21 @@
 
 #include "Fixed.h"
 
+//------------------------------------------------------------------------------
+// Definitions
+
+#define LEDS_LED1   0x01    // trigger bits
+#define LEDS_LED2   0x02
+#define LEDS_LED3   0x04
+
 //------------------------------------------------------------------------------
 // Function declarations
 
 void LedsInit(void);
-void LedsUpdate(Fixed audioSample);
+int LedsDetect(const Fixed audioSample, const int isSilent);
+Fixed LedsGetThreshold(const int ledNumber);
+void LedsRender(const int triggers);
+unsigned int LedsGetDuty(const int ledNumber);
 
 #endif
 
@@ -0,0 +1,128 @@
+/*
+    Packet.c
+    Author: agent
+
+    Binary packets sent over UART 2.  Each packet is structured as:
+
+    Byte    Description
+    0       PACKET_SYNC (0x7E)
+    1       packet type (see PacketType)
+    2       payload length (n)
+    3..n+2  payload
+    n+3     checksum (8-bit sum of bytes 1 to n+2, negated)
+
+    Bytes are not escaped so the receiver must resynchronise by searching for
+    PACKET_SYNC and discarding packets with an invalid checksum.  The sum of
+    bytes 1 to n+3 of a valid packet is zero.
+
+    The caller must check PacketIsPutReady() before calling PacketBegin().
+
+    PacketGet() must only be called when the next byte in the UART 2 RX buffer
+    is PACKET_SYNC.  It returns the payload length once the complete packet has
+    been received, PACKET_GET_INCOMPLETE if more bytes are required,
+    PACKET_GET_INVALID if the packet was discarded, or PACKET_GET_TOO_LONG if a
+    valid packet was discarded because its payload is longer than maxLength.
+    A follower receives every packet sent by the leader (e.g. telemetry and
+    audio capture) so a valid packet is always consumed in full, whatever its
+    length, so that its payload is not parsed as commands.  Only the sync byte
+    of an invalid packet is discarded so that the following bytes are searched
+    for the next packet.  A packet is also treated as invalid if it could never
+    fit in the RX buffer or if it remains incomplete for INCOMPLETE_TIMEOUT
+    calls, so that a corrupt length byte cannot stall the command parser.
+    PacketGet() is expected to be called once per audio sample while a packet
+    is incomplete.
+*/
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include "Packet.h"
+#include "Uart/Uart2.h"
+
+//------------------------------------------------------------------------------
+// Definitions
+
+#define PEEK(offset) ((unsigned char)uart2RxBuf[(unsigned char)(uart2RxBufOut + (offset))])
+#define MAX_PACKET_LENGTH   255     // maximum number of bytes in RX buffer
+#define INCOMPLETE_TIMEOUT  403     // calls, 100 ms at 4032 Hz
+
+//------------------------------------------------------------------------------
+// Variables
+
+static unsigned char checksum;
+static unsigned int incompleteCount = 0;
+
+//------------------------------------------------------------------------------
+// Functions
+
+void PacketBegin(const PacketType packetType, const unsigned char length) {
+    Uart2PutChar(PACKET_SYNC);
+    Uart2PutChar(packetType);
+    Uart2PutChar(length);
+    checksum = (unsigned char)packetType + length;
+}
+
+void PacketPut(const unsigned char byte) {
+    Uart2PutChar(byte);
+    checksum += byte;
+}
+
+void PacketEnd(void) {
+    Uart2PutChar((unsigned char)-checksum);
+}
+
+int PacketGet(PacketType* const packetType, unsigned char* const payload, const unsigned char maxLength) {
+    unsigned char available = Uart2IsGetReady();
+    unsigned char length;
+    unsigned char sum;
+    unsigned char i;
+
+    // Wait for complete packet
+    if(available < 3) {
+        length = 0;
+    }
+    else {
+        length = PEEK(2);
+        if(length + PACKET_OVERHEAD > MAX_PACKET_LENGTH) {
+            incompleteCount = 0;
+            uart2RxBufOut++;    // discard sync byte
+            return PACKET_GET_INVALID;
+        }
+    }
+    if((available < 3) || (available < length + PACKET_OVERHEAD)) {
+        if(++incompleteCount < INCOMPLETE_TIMEOUT) {
+            return PACKET_GET_INCOMPLETE;
+        }
+        incompleteCount = 0;
+        uart2RxBufOut++;    // discard sync byte
+        return PACKET_GET_INVALID;
+    }
+    incompleteCount = 0;
+
+    // Verify checksum
+    sum = 0;
+    for(i = 1; i < length + PACKET_OVERHEAD; i++) {
+        sum += PEEK(i);
+    }
+    if(sum != 0) {
+        uart2RxBufOut++;    // discard sync byte
+        return PACKET_GET_INVALID;
+    }
+
+    // Discard valid packet that is too long
+    if(length > maxLength) {
+        uart2RxBufOut += length + PACKET_OVERHEAD;
+        return PACKET_GET_TOO_LONG;
+    }
+
+    // Fetch packet
+    *packetType = PEEK(1);
+    for(i = 0; i < length; i++) {
+        payload[i] = PEEK(3 + i);
+    }
+    uart2RxBufOut += length + PACKET_OVERHEAD;
+    return length;
+}
+
+//------------------------------------------------------------------------------
+// End of file
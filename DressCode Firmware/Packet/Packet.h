@@ -0,0 +1,48 @@
+/*
+    Packet.h
+    Author: agent
+*/
+
+#ifndef Packet_h
+#define Packet_h
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include "Uart/Uart2.h"
+
+//------------------------------------------------------------------------------
+// Definitions
+
+typedef enum {
+    PACKET_TYPE_AUDIO_CAPTURE = 0x01,
+    PACKET_TYPE_TELEMETRY = 0x02,
+    PACKET_TYPE_SYNC = 0x03,
+    PACKET_TYPE_STATUS = 0x04,
+    PACKET_TYPE_LATENCY = 0x05,
+    PACKET_TYPE_TRACE = 0x06
+} PacketType;
+
+#define PACKET_SYNC     0x7E    // first byte of every packet
+#define PACKET_OVERHEAD 4       // sync, type, length and checksum bytes
+#define PACKET_GET_INCOMPLETE   (-1)
+#define PACKET_GET_INVALID      (-2)
+#define PACKET_GET_TOO_LONG     (-3)
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+void PacketBegin(const PacketType packetType, const unsigned char length);
+void PacketPut(const unsigned char byte);
+void PacketEnd(void);
+int PacketGet(PacketType* const packetType, unsigned char* const payload, const unsigned char maxLength);
+
+//------------------------------------------------------------------------------
+// Macros
+
+#define PacketIsPutReady(length) (Uart2IsPutReady() >= (length) + PACKET_OVERHEAD)
+
+#endif
+
+//------------------------------------------------------------------------------
+// End of file
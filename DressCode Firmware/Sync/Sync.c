@@ -0,0 +1,168 @@
+/*
+    Sync.c
+    Author: agent
+
+    Synchronises the LEDs of several garments.  The leader's UART 2 TX is wired
+    to the UART 2 RX of each follower.  The leader sends its LED triggers (the
+    LED thresholds exceeded by its envelope) as a packet of type
+    PACKET_TYPE_SYNC (see Packet.c) each time they change, and every
+    REFRESH_PERIOD samples so that a follower recovers from a lost packet.
+    Followers render the leader's triggers instead of their own.
+
+    A follower's UART 2 RX is wired to the leader's TX so the 'S' command
+    cannot reach it.  A device that is off therefore becomes a follower when
+    it receives a valid sync packet, and a follower reverts to off if no sync
+    packet is received for FOLLOWER_TIMEOUT samples (the leader refreshes every
+    REFRESH_PERIOD).  main.c ignores all commands other than packets while
+    following so that noise on the link cannot change the follower's state.
+
+    Payload:
+
+    Byte    Description
+    0       sequence number
+    1       LED triggers (LEDS_LED1, LEDS_LED2, LEDS_LED3)
+    2       samples the follower should wait before rendering the triggers
+
+    Latency compensation: the leader delays its own rendering by
+    LATENCY_SAMPLES.  The time for the packet to reach a follower is estimated
+    from the number of bytes queued in the UART TX buffer ahead of the packet
+    and the follower is told to wait for the remainder of LATENCY_SAMPLES.  The
+    estimate assumes 250 kbaud (25 bytes/ms, 6.2 bytes per sample) and is
+    rounded up to whole samples.  The rounding accounts for the follower
+    waiting for its next sample to process the packet, which it does in the
+    same sample as SyncUpdate() so no further allowance is made.  The follower
+    renders within half a sample of the leader on average, plus the phase
+    difference between their sample clocks (see Host/SyncPty).
+*/
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include "Leds/Leds.h"
+#include "Packet/Packet.h"
+#include "Sync.h"
+#include "Trace/Trace.h"
+#include "Uart/Uart2.h"
+
+//------------------------------------------------------------------------------
+// Definitions
+
+#define LATENCY_SAMPLES 8       // must be a power of 2, 8 samples = 2 ms
+#define REFRESH_PERIOD  1008    // samples, 250 ms
+#define FOLLOWER_TIMEOUT (4 * REFRESH_PERIOD)   // samples without a sync packet, 1 s
+
+//------------------------------------------------------------------------------
+// Variables
+
+static SyncMode mode = SYNC_MODE_OFF;
+static unsigned char delayLine[LATENCY_SAMPLES];
+static unsigned char delayLineIndex;
+static int lastTriggers;
+static unsigned int refreshTimer;
+static unsigned int followerTimer;
+static unsigned char sequence;
+static int followerTriggers;
+static int pendingTriggers;
+static int pendingDelay = -1;   // -1 if no triggers pending
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+static void sendTriggers(const int triggers);
+
+//------------------------------------------------------------------------------
+// Functions
+
+void SyncSetMode(const SyncMode syncMode) {
+    int i;
+    for(i = 0; i < LATENCY_SAMPLES; i++) {
+        delayLine[i] = 0;
+    }
+    lastTriggers = -1;  // force send of first triggers
+    refreshTimer = 0;
+    followerTimer = 0;
+    followerTriggers = 0;
+    pendingDelay = -1;
+    mode = syncMode;
+    TraceMain(TRACE_EVENT_SYNC_MODE, mode);
+}
+
+SyncMode SyncGetMode(void) {
+    return mode;
+}
+
+int SyncUpdate(const int triggers) {
+    int delayedTriggers;
+    switch(mode) {
+        case SYNC_MODE_LEADER:
+
+            // Send triggers if changed or refresh due
+            if(++refreshTimer >= REFRESH_PERIOD) {
+                lastTriggers = -1;
+            }
+            if(triggers != lastTriggers) {
+                sendTriggers(triggers);
+            }
+
+            // Delay own rendering to match followers
+            delayLineIndex = (delayLineIndex + 1) & (LATENCY_SAMPLES - 1);
+            delayedTriggers = delayLine[delayLineIndex];
+            delayLine[delayLineIndex] = triggers;
+            return delayedTriggers;
+
+        case SYNC_MODE_FOLLOWER:
+            if(++followerTimer >= FOLLOWER_TIMEOUT) {
+                SyncSetMode(SYNC_MODE_OFF); // leader lost
+                return triggers;
+            }
+            if(pendingDelay >= 0) {
+                if(pendingDelay-- == 0) {
+                    followerTriggers = pendingTriggers;
+                }
+            }
+            return followerTriggers;
+
+        default:
+            return triggers;
+    }
+}
+
+void SyncReceive(const unsigned char* const payload, const int length) {
+    if(length != SYNC_PAYLOAD_LENGTH) {
+        return;
+    }
+    if(mode == SYNC_MODE_OFF) {
+        SyncSetMode(SYNC_MODE_FOLLOWER);    // leader detected
+    }
+    if(mode != SYNC_MODE_FOLLOWER) {
+        return;
+    }
+    followerTimer = 0;
+    if(pendingDelay >= 0) {
+        followerTriggers = pendingTriggers; // apply previous triggers now
+    }
+    pendingTriggers = payload[1];
+    pendingDelay = payload[2];
+}
+
+static void sendTriggers(const int triggers) {
+    unsigned int queuedBytes = uart2TxBufCount + SYNC_PAYLOAD_LENGTH + PACKET_OVERHEAD;
+    int transmitSamples = (int)((queuedBytes * 41 + 255) >> 8);    // bytes / 6.2 rounded up
+    int followerDelay = LATENCY_SAMPLES - transmitSamples;
+    if(!PacketIsPutReady(SYNC_PAYLOAD_LENGTH)) {
+        return; // retry next sample
+    }
+    if(followerDelay < 0) {
+        followerDelay = 0;  // cannot compensate, TX buffer too full
+    }
+    PacketBegin(PACKET_TYPE_SYNC, SYNC_PAYLOAD_LENGTH);
+    PacketPut(sequence++);
+    PacketPut((unsigned char)triggers);
+    PacketPut((unsigned char)followerDelay);
+    PacketEnd();
+    lastTriggers = triggers;
+    refreshTimer = 0;
+}
+
+//------------------------------------------------------------------------------
+// End of file
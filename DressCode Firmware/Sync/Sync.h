@@ -0,0 +1,31 @@
+/*
+    Sync.h
+    Author: agent
+*/
+
+#ifndef Sync_h
+#define Sync_h
+
+//------------------------------------------------------------------------------
+// Definitions
+
+typedef enum {
+    SYNC_MODE_OFF,
+    SYNC_MODE_LEADER,
+    SYNC_MODE_FOLLOWER
+} SyncMode;
+
+#define SYNC_PAYLOAD_LENGTH 3
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+void SyncSetMode(const SyncMode syncMode);
+SyncMode SyncGetMode(void);
+int SyncUpdate(const int triggers);
+void SyncReceive(const unsigned char* const payload, const int length);
+
+#endif
+
+//------------------------------------------------------------------------------
+// End of file
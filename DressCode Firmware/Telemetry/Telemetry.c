@@ -0,0 +1,263 @@
+/*
+    Telemetry.c
+    Author: agent
+
+    Streams selected internal state over UART 2.  Each channel is sent once
+    every 'decimation' audio samples (0 = disabled).  TelemetryUpdate() must be
+    called once per audio sample.
+
+    The channels due for each sample are sent as a single packet of type
+    PACKET_TYPE_TELEMETRY (see Packet.c) with the payload:
+
+    Byte    Description
+    0-1     sample counter (unsigned 16-bit, little-endian)
+    2-3     channel mask (bit n set if TelemetryChannel n is present)
+    4..     channel values in TelemetryChannel order, little-endian
+
+    TelemetrySetChannel() rejects a configuration if the worst-case data rate
+    would exceed TELEMETRY_MAX_BYTES_PER_SECOND.  This leaves room for the audio
+    capture stream within the 25 kB/s available at 250 kbaud.  The worst case
+    charges the packet header and overhead to every enabled channel because
+    channels with co-prime decimations are rarely due on the same sample.  Packets are
+    dropped if the UART TX buffer is full; the sample counter allows the host
+    to detect this.
+
+    TelemetrySetRateShift() multiplies all decimations by 2^rateShift so that
+    the rate can be reduced if the host cannot keep up, e.g. when flow control
+    is holding off transmission.
+
+    While telemetry or audio capture is enabled, a packet of type
+    PACKET_TYPE_STATUS is sent every STATUS_PERIOD samples with the payload:
+
+    Byte    Description
+    0-1     UART 2 RX overrun count (unsigned 16-bit, little-endian)
+    2-3     UART 2 RX framing error count
+    4-5     UART 2 TX dropped byte count
+    6       telemetry rate shift
+    7-8     enabled channel mask (bit n set if TelemetryChannel n is enabled)
+
+    A status packet is also sent on the next TelemetryUpdate() after each call
+    to TelemetrySetChannel() or TelemetryDisable() so that the host can confirm
+    which channels were accepted.
+*/
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include "AudioCapture/AudioCapture.h"
+#include "AudioIn/AudioIn.h"
+#include "Battery/Battery.h"
+#include "Leds/Leds.h"
+#include "Packet/Packet.h"
+#include "Telemetry.h"
+#include "Uart/Uart2.h"
+
+//------------------------------------------------------------------------------
+// Definitions
+
+#define SAMPLE_RATE                     4032    // Hz
+#define TELEMETRY_MAX_BYTES_PER_SECOND  20000
+#define HEADER_LENGTH                   4
+#define STATUS_PERIOD                   4032    // samples, 1 second
+#define STATUS_LENGTH                   9
+
+//------------------------------------------------------------------------------
+// Variables
+
+static unsigned int decimations[TELEMETRY_CHANNEL_COUNT];
+static unsigned int counters[TELEMETRY_CHANNEL_COUNT];
+static unsigned int sampleCounter = 0;
+static int rateShift = 0;
+static unsigned int statusTimer = 0;
+static int isStatusPending = 0;
+static const unsigned char channelSizes[TELEMETRY_CHANNEL_COUNT] = { 2, 4, 4, 4, 4, 1, 2, 2, 2, 1, 2, 1, 2 };
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+static unsigned int getEnabledMask(void);
+static void sendStatus(void);
+static void putInt(const unsigned int value);
+static void putLong(const unsigned long value);
+
+//------------------------------------------------------------------------------
+// Functions
+
+int TelemetrySetChannel(const TelemetryChannel telemetryChannel, const unsigned int decimation) {
+    int i;
+    unsigned long bytesPerSecond = 0;
+
+    isStatusPending = 1;    // acknowledge with channel mask
+    if(telemetryChannel >= TELEMETRY_CHANNEL_COUNT) {
+        return 1;
+    }
+
+    // Calculate worst-case data rate for new configuration
+    for(i = 0; i < TELEMETRY_CHANNEL_COUNT; i++) {
+        unsigned int d = i == telemetryChannel ? decimation : decimations[i];
+        if(d == 0) {
+            continue;
+        }
+        bytesPerSecond += (unsigned long)(channelSizes[i] + HEADER_LENGTH + PACKET_OVERHEAD) * SAMPLE_RATE / d;
+    }
+    if(bytesPerSecond > TELEMETRY_MAX_BYTES_PER_SECOND) {
+        return 1;   // exceeds UART budget
+    }
+
+    // Apply configuration
+    decimations[telemetryChannel] = decimation;
+    counters[telemetryChannel] = decimation;
+    return 0;
+}
+
+void TelemetryDisable(void) {
+    int i;
+    for(i = 0; i < TELEMETRY_CHANNEL_COUNT; i++) {
+        decimations[i] = 0;
+    }
+    isStatusPending = 1;
+}
+
+void TelemetrySetRateShift(const int newRateShift) {
+    rateShift = newRateShift < 0 ? 0 : newRateShift > TELEMETRY_MAX_RATE_SHIFT ? TELEMETRY_MAX_RATE_SHIFT : newRateShift;
+}
+
+int TelemetryGetRateShift(void) {
+    return rateShift;
+}
+
+int TelemetryIsEnabled(void) {
+    return getEnabledMask() != 0;
+}
+
+void TelemetryUpdate(void) {
+    int i;
+    unsigned int channelMask = 0;
+    unsigned char length = HEADER_LENGTH;
+    AudioInStatus audioInStatus;
+
+    sampleCounter++;
+
+    // Send status
+    if(++statusTimer >= STATUS_PERIOD) {
+        statusTimer = 0;
+        if(TelemetryIsEnabled() || AudioCaptureIsEnabled()) {
+            isStatusPending = 1;
+        }
+    }
+    if(isStatusPending) {
+        isStatusPending = 0;
+        sendStatus();
+    }
+
+    // Determine which channels are due
+    for(i = 0; i < TELEMETRY_CHANNEL_COUNT; i++) {
+        if(decimations[i] == 0) {
+            continue;
+        }
+        if(--counters[i] == 0) {
+            unsigned long decimation = (unsigned long)decimations[i] << rateShift;
+            counters[i] = decimation > 0xFFFF ? 0xFFFF : (unsigned int)decimation;
+            channelMask |= 1 << i;
+            length += channelSizes[i];
+        }
+    }
+    if(channelMask == 0) {
+        return;
+    }
+    if(!PacketIsPutReady(length)) {
+        Uart2TxDropped(length + PACKET_OVERHEAD);
+        return; // drop packet
+    }
+
+    // Send packet
+    AudioInGetStatus(&audioInStatus);
+    PacketBegin(PACKET_TYPE_TELEMETRY, length);
+    putInt(sampleCounter);
+    putInt(channelMask);
+    for(i = 0; i < TELEMETRY_CHANNEL_COUNT; i++) {
+        if((channelMask & (1 << i)) == 0) {
+            continue;
+        }
+        switch(i) {
+            case TELEMETRY_CHANNEL_ADC:
+                putInt(audioInStatus.adc);
+                break;
+            case TELEMETRY_CHANNEL_BIAS:
+                putLong(audioInStatus.bias);
+                break;
+            case TELEMETRY_CHANNEL_ENVELOPE:
+                putLong(audioInStatus.envelope);
+                break;
+            case TELEMETRY_CHANNEL_GAIN:
+                putLong(audioInStatus.gain);
+                break;
+            case TELEMETRY_CHANNEL_SW_GAIN:
+                putLong(audioInStatus.swGain);
+                break;
+            case TELEMETRY_CHANNEL_PREAMP_GAIN:
+                PacketPut(audioInStatus.preampGain);
+                break;
+            case TELEMETRY_CHANNEL_LED1:
+                putInt(LedsGetDuty(1));
+                break;
+            case TELEMETRY_CHANNEL_LED2:
+                putInt(LedsGetDuty(2));
+                break;
+            case TELEMETRY_CHANNEL_LED3:
+                putInt(LedsGetDuty(3));
+                break;
+            case TELEMETRY_CHANNEL_BATTERY:
+                PacketPut(BatteryIsCharging());
+                break;
+            case TELEMETRY_CHANNEL_BATTERY_MV:
+                putInt(BatteryGetMillivolts());
+                break;
+            case TELEMETRY_CHANNEL_BATTERY_TIER:
+                PacketPut(BatteryGetTier());
+                break;
+            case TELEMETRY_CHANNEL_RUNTIME:
+                putInt(BatteryGetRuntime());
+                break;
+        }
+    }
+    PacketEnd();
+}
+
+static unsigned int getEnabledMask(void) {
+    int i;
+    unsigned int enabledMask = 0;
+    for(i = 0; i < TELEMETRY_CHANNEL_COUNT; i++) {
+        if(decimations[i] != 0) {
+            enabledMask |= 1 << i;
+        }
+    }
+    return enabledMask;
+}
+
+static void sendStatus(void) {
+    if(!PacketIsPutReady(STATUS_LENGTH)) {
+        Uart2TxDropped(STATUS_LENGTH + PACKET_OVERHEAD);
+        return;
+    }
+    PacketBegin(PACKET_TYPE_STATUS, STATUS_LENGTH);
+    putInt(uart2RxOverrunCount);
+    putInt(uart2FramingErrorCount);
+    putInt(uart2TxDroppedCount);
+    PacketPut((unsigned char)rateShift);
+    putInt(getEnabledMask());
+    PacketEnd();
+}
+
+static void putInt(const unsigned int value) {
+    PacketPut((unsigned char)value);
+    PacketPut((unsigned char)(value >> 8));
+}
+
+static void putLong(const unsigned long value) {
+    putInt((unsigned int)value);
+    putInt((unsigned int)(value >> 16));
+}
+
+//------------------------------------------------------------------------------
+// End of file
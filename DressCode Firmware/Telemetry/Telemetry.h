@@ -0,0 +1,44 @@
+/*
+    Telemetry.h
+    Author: agent
+*/
+
+#ifndef Telemetry_h
+#define Telemetry_h
+
+//------------------------------------------------------------------------------
+// Definitions
+
+typedef enum {
+    TELEMETRY_CHANNEL_ADC,          // mean of 16 ADC samples, unsigned 16-bit
+    TELEMETRY_CHANNEL_BIAS,         // Fixed
+    TELEMETRY_CHANNEL_ENVELOPE,     // Fixed
+    TELEMETRY_CHANNEL_GAIN,         // Fixed
+    TELEMETRY_CHANNEL_SW_GAIN,      // Fixed
+    TELEMETRY_CHANNEL_PREAMP_GAIN,  // PreampGain, 8-bit
+    TELEMETRY_CHANNEL_LED1,         // PWM duty, unsigned 16-bit
+    TELEMETRY_CHANNEL_LED2,         // PWM duty, unsigned 16-bit
+    TELEMETRY_CHANNEL_LED3,         // PWM duty, unsigned 16-bit
+    TELEMETRY_CHANNEL_BATTERY,      // 1 if charging, 8-bit
+    TELEMETRY_CHANNEL_BATTERY_MV,   // filtered battery voltage (mV), unsigned 16-bit
+    TELEMETRY_CHANNEL_BATTERY_TIER, // BatteryTier, 8-bit
+    TELEMETRY_CHANNEL_RUNTIME,      // estimated remaining runtime (minutes), unsigned 16-bit
+    TELEMETRY_CHANNEL_COUNT
+} TelemetryChannel;
+
+#define TELEMETRY_MAX_RATE_SHIFT    4   // rate reduced by up to 16
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+int TelemetrySetChannel(const TelemetryChannel telemetryChannel, const unsigned int decimation);
+void TelemetryDisable(void);
+void TelemetrySetRateShift(const int newRateShift);
+int TelemetryGetRateShift(void);
+int TelemetryIsEnabled(void);
+void TelemetryUpdate(void);
+
+#endif
+
+//------------------------------------------------------------------------------
+// End of file
@@ -0,0 +1,182 @@
+/*
+    Trace.c
+    Author: agent
+
+    Records events in RAM for post-mortem analysis.  Each interrupt priority
+    level that records events has its own ring of records so that each ring
+    has a single writer and recording is lock-free: TraceIsr() for the ADC ISR
+    (priority 7) and TraceMain() for the main loop.  The host merges the rings
+    by timestamp (see Host/TraceDecode.py).  The UART drivers do not depend on
+    this module; the main loop traces UART errors from the driver's error
+    counters.
+
+    Timer 2 runs at 62.5 kHz (16 us per tick) and wraps every 1.05 s.  The ADC
+    ISR ring is timestamped with Timer 2 directly because its 16 records span
+    only a few milliseconds.  The main loop ring records events that may be
+    minutes apart so it is timestamped by TraceGetMainTime() with Timer 2
+    extended in software and divided by 256 (4.096 ms per tick), which wraps
+    every 268 s.  The extension counts Timer 2 wraps so TraceGetMainTime() must
+    be called at least once per 1.05 s, which TraceTasks() does.
+
+    Recording stops when the trace is frozen by TraceFreezeNow(), either on an
+    anomaly (UART RX overrun, see main.c, or preamp gain chatter, see
+    AudioIn.c) or by TraceDump().  TraceDump() sends each ring as a packet of
+    type PACKET_TYPE_TRACE (see Packet.c) with the payload:
+
+    Byte    Description
+    0       ring (0 = ADC ISR, 1 = main loop)
+    1       freeze reason (TraceFreeze)
+    2-3     freeze time (ticks of the ring's timebase, little-endian)
+    4       number of records (n)
+    5..     n records, oldest first, each: time (2 bytes, little-endian),
+            event (TraceEvent), argument
+
+    TraceResume() clears the rings and resumes recording.
+*/
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include "Packet/Packet.h"
+#include "Trace.h"
+#include <p24Fxxxx.h>
+
+//------------------------------------------------------------------------------
+// Definitions
+
+#define HEADER_LENGTH   5
+#define RECORD_LENGTH   4       // bytes per record in packet
+#define NUMBER_OF_RINGS 2
+
+//------------------------------------------------------------------------------
+// Variables
+
+volatile unsigned int traceEvents = TRACE_DEFAULT_EVENTS;
+volatile TraceFreeze traceFreeze = TRACE_FREEZE_NONE;
+volatile unsigned int traceFreezeTime;
+static unsigned long ticks = 0;             // Timer 2 extended to 32 bits
+static unsigned int mainFreezeTime;         // freeze time in main loop ring ticks
+static int isMainFreezeTimeValid = 0;
+TraceRecord traceIsrRecords[TRACE_ISR_SIZE];
+unsigned char traceIsrIndex = 0;
+TraceRecord traceMainRecords[TRACE_MAIN_SIZE];
+unsigned char traceMainIndex = 0;
+static int dumpRing = NUMBER_OF_RINGS;  // next ring to dump, NUMBER_OF_RINGS if none
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+static unsigned long getTicks(void);
+static void clearRing(TraceRecord* const records, const unsigned char size);
+static int sendRing(const unsigned char ring, const unsigned int freezeTime, const TraceRecord* const records, const unsigned char index, const unsigned char size);
+
+//------------------------------------------------------------------------------
+// Functions
+
+void TraceInit(void) {
+    TraceResume();
+    T2CONbits.TCKPS = 0b10; // 1:64 prescale, 62.5 kHz at 4 MIPS
+    PR2 = 0xFFFF;
+    T2CONbits.TON = 1;
+}
+
+void TraceDump(void) {
+    TraceFreezeNow(TRACE_FREEZE_COMMAND);
+    dumpRing = 0;
+}
+
+void TraceResume(void) {
+    dumpRing = NUMBER_OF_RINGS;
+    clearRing(traceIsrRecords, TRACE_ISR_SIZE);
+    clearRing(traceMainRecords, TRACE_MAIN_SIZE);
+    isMainFreezeTimeValid = 0;
+    traceFreeze = TRACE_FREEZE_NONE;
+}
+
+void TraceTasks(void) {
+    int sent = 1;
+
+    // Convert freeze time to main loop ring timebase, requires freeze less than 1.05 s ago
+    int isFrozen = traceFreeze != TRACE_FREEZE_NONE;  // read before Timer 2 in case ISR freezes
+    unsigned long now = getTicks();
+    if(isFrozen && !isMainFreezeTimeValid) {
+        unsigned int elapsed = ((unsigned int)now - traceFreezeTime) & 0xFFFF;
+        mainFreezeTime = (unsigned int)((now - elapsed) >> 8);
+        isMainFreezeTimeValid = 1;
+    }
+
+    // Send dump
+    switch(dumpRing) {
+        case 0:
+            sent = sendRing(0, traceFreezeTime, traceIsrRecords, traceIsrIndex, TRACE_ISR_SIZE);
+            break;
+        case 1:
+            sent = sendRing(1, mainFreezeTime, traceMainRecords, traceMainIndex, TRACE_MAIN_SIZE);
+            break;
+        default:
+            return;
+    }
+    if(sent) {
+        dumpRing++;
+    }
+}
+
+unsigned int TraceGetMainTime(void) {
+    return (unsigned int)(getTicks() >> 8);
+}
+
+static unsigned long getTicks(void) {
+    unsigned int timer = TMR2;
+    if(timer < (unsigned int)(ticks & 0xFFFF)) {
+        ticks += 0x10000;   // Timer 2 wrapped
+    }
+    ticks = (ticks & 0xFFFF0000) | timer;
+    return ticks;
+}
+
+static void clearRing(TraceRecord* const records, const unsigned char size) {
+    unsigned char i;
+    for(i = 0; i < size; i++) {
+        records[i].event = TRACE_EVENT_NONE;
+    }
+}
+
+static int sendRing(const unsigned char ring, const unsigned int freezeTime, const TraceRecord* const records, const unsigned char index, const unsigned char size) {
+    unsigned char count = 0;
+    unsigned char length;
+    unsigned char i;
+
+    // Count records, ring is not full if records are empty
+    for(i = 0; i < size; i++) {
+        if(records[i].event != TRACE_EVENT_NONE) {
+            count++;
+        }
+    }
+    length = HEADER_LENGTH + (count * RECORD_LENGTH);
+    if(!PacketIsPutReady(length)) {
+        return 0;   // retry next sample
+    }
+
+    // Send records, oldest first
+    PacketBegin(PACKET_TYPE_TRACE, length);
+    PacketPut(ring);
+    PacketPut(traceFreeze);
+    PacketPut((unsigned char)freezeTime);
+    PacketPut((unsigned char)(freezeTime >> 8));
+    PacketPut(count);
+    for(i = 0; i < size; i++) {
+        const TraceRecord* const record = &records[(unsigned char)(index + i) & (size - 1)];
+        if(record->event == TRACE_EVENT_NONE) {
+            continue;
+        }
+        PacketPut((unsigned char)record->time);
+        PacketPut((unsigned char)(record->time >> 8));
+        PacketPut(record->event);
+        PacketPut(record->argument);
+    }
+    PacketEnd();
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+// End of file
@@ -0,0 +1,90 @@
+/*
+    Trace.h
+    Author: agent
+*/
+
+#ifndef Trace_h
+#define Trace_h
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include <p24Fxxxx.h>
+
+//------------------------------------------------------------------------------
+// Definitions
+
+typedef enum {
+    TRACE_EVENT_ADC_ISR_ENTRY,
+    TRACE_EVENT_ADC_ISR_EXIT,
+    TRACE_EVENT_PREAMP_GAIN,        // argument is PreampGain
+    TRACE_EVENT_UART_RX_OVERRUN,    // argument is number of new overruns
+    TRACE_EVENT_UART_FRAMING_ERROR, // argument is number of new framing errors
+    TRACE_EVENT_BATTERY_TIER,       // argument is BatteryTier
+    TRACE_EVENT_CHARGING,           // argument is 1 if charging
+    TRACE_EVENT_SYNC_MODE,          // argument is SyncMode
+    TRACE_EVENT_NONE = 0xFF         // empty record
+} TraceEvent;
+
+typedef enum {
+    TRACE_FREEZE_NONE,
+    TRACE_FREEZE_COMMAND,
+    TRACE_FREEZE_UART_OVERRUN,
+    TRACE_FREEZE_GAIN_CHATTER
+} TraceFreeze;
+
+typedef struct {
+    unsigned int time;  // Timer 2 ticks (ADC ISR ring) or TraceGetMainTime() (main loop ring)
+    unsigned char event;
+    unsigned char argument;
+} TraceRecord;
+
+#define TRACE_ISR_SIZE      16  // records, must be a power of 2
+#define TRACE_MAIN_SIZE     32
+#define TRACE_DEFAULT_EVENTS 0xFFFC // all except ADC ISR entry and exit
+
+//------------------------------------------------------------------------------
+// Variable declarations
+
+extern volatile unsigned int traceEvents;
+extern volatile TraceFreeze traceFreeze;
+extern volatile unsigned int traceFreezeTime;
+extern TraceRecord traceIsrRecords[TRACE_ISR_SIZE];
+extern unsigned char traceIsrIndex;
+extern TraceRecord traceMainRecords[TRACE_MAIN_SIZE];
+extern unsigned char traceMainIndex;
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+void TraceInit(void);
+void TraceDump(void);
+void TraceResume(void);
+void TraceTasks(void);
+unsigned int TraceGetMainTime(void);
+
+//------------------------------------------------------------------------------
+// Macros
+
+#define TRACE_PUT(ring, size, traceTime, traceEvent, traceArgument) {           \
+    if((traceFreeze == TRACE_FREEZE_NONE) && (traceEvents & (1 << (traceEvent)))) { \
+        TraceRecord* traceRecord = &ring##Records[ring##Index & ((size) - 1)];  \
+        traceRecord->time = (traceTime);                                        \
+        traceRecord->event = (traceEvent);                                      \
+        traceRecord->argument = (traceArgument);                                \
+        ring##Index++;                                                          \
+    }                                                                           \
+}
+#define TraceIsr(traceEvent, traceArgument) TRACE_PUT(traceIsr, TRACE_ISR_SIZE, TMR2, traceEvent, traceArgument)
+#define TraceMain(traceEvent, traceArgument) TRACE_PUT(traceMain, TRACE_MAIN_SIZE, TraceGetMainTime(), traceEvent, traceArgument)
+#define TraceFreezeNow(reason) {                \
+    if(traceFreeze == TRACE_FREEZE_NONE) {      \
+        traceFreezeTime = TMR2;                 \
+        traceFreeze = (reason);                 \
+    }                                           \
+}
+
+#endif
+
+//------------------------------------------------------------------------------
+// End of file
@@ -18,11 +18,13 @@
 volatile char uart1RxBuf[256];
 volatile unsigned char uart1RxBufIn = 0;
 volatile unsigned char uart1RxBufOut = 0;
-volatile int uart1RxBufOverrun = 0;
 volatile char uart1TxBuf[256];
 volatile unsigned char uart1TxBufIn = 0;
 volatile unsigned char uart1TxBufOut = 0;
 volatile unsigned char uart1TxBufCount = 0;
+volatile unsigned int uart1RxOverrunCount = 0;
+volatile unsigned int uart1FramingErrorCount = 0;
+volatile unsigned int uart1TxDroppedCount = 0;
 
 //------------------------------------------------------------------------------
 // Functions
@@ -60,10 +62,13 @@ void Uart1PutString(const char* str) {
 
 void __attribute__((interrupt, auto_psv))_U1RXInterrupt(void) {
     while(U1STAbits.URXDA) {    // repeat while data available
+        if(U1STAbits.FERR) {    // framing error for character at top of FIFO
+            uart1FramingErrorCount++;
+        }
         uart1RxBuf[uart1RxBufIn] = U1RXREG; // fetch data from buffer
         uart1RxBufIn++;
         if(uart1RxBufIn == uart1RxBufOut) { // check for FIFO overrun
-            uart1RxBufOverrun = 1;
+            uart1RxOverrunCount++;
         }
     }
     _U1RXIF = 0;    // data received immediately before clearing UxRXIF will be unhandled, URXDA should be polled to set UxRXIF
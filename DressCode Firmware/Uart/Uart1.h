@@ -18,11 +18,13 @@
 extern volatile char uart1RxBuf[256];
 extern volatile unsigned char uart1RxBufIn;
 extern volatile unsigned char uart1RxBufOut;
-extern volatile int uart1RxBufOverrun;
 extern volatile char uart1TxBuf[256];
 extern volatile unsigned char uart1TxBufIn;
 extern volatile unsigned char uart1TxBufOut;
 extern volatile unsigned char uart1TxBufCount;
+extern volatile unsigned int uart1RxOverrunCount;
+extern volatile unsigned int uart1FramingErrorCount;
+extern volatile unsigned int uart1TxDroppedCount;
 
 //------------------------------------------------------------------------------
 // Function declarations
@@ -45,9 +47,18 @@ void Uart1PutString(const char* str);
         _U1TXIE = 1;                \
     }                               \
 }
-#define Uart1FlushRxBuf() { uart1RxBufOut = uart1RxBufIn; uart1RxBufOverrun = 0; }
+#define Uart1FlushRxBuf() { uart1RxBufOut = uart1RxBufIn; }
 #define Uart1FlushTxBuf() { uart1TxBufOut = uart1TxBufIn; uart1TxBufCount = 0; }
-#define Uart1RxTasks() { if(U1STAbits.URXDA) { _U1RXIF = 1; } U1STAbits.OERR = 0; }
+#define Uart1RxTasks() {            \
+    if(U1STAbits.URXDA) {           \
+        _U1RXIF = 1;                \
+    }                               \
+    if(U1STAbits.OERR) {            \
+        uart1RxOverrunCount++;      \
+        U1STAbits.OERR = 0;         \
+    }                               \
+}
+#define Uart1TxDropped(numberOfBytes) { uart1TxDroppedCount += (numberOfBytes); }
 #define Uart1TxIsIdle() (_U1TXIE != 0)
 
 #endif
@@ -18,11 +18,13 @@
 volatile char uart2RxBuf[256];
 volatile unsigned char uart2RxBufIn = 0;
 volatile unsigned char uart2RxBufOut = 0;
-volatile int uart2RxBufOverrun = 0;
 volatile char uart2TxBuf[256];
 volatile unsigned char uart2TxBufIn = 0;
 volatile unsigned char uart2TxBufOut = 0;
 volatile unsigned char uart2TxBufCount = 0;
+volatile unsigned int uart2RxOverrunCount = 0;
+volatile unsigned int uart2FramingErrorCount = 0;
+volatile unsigned int uart2TxDroppedCount = 0;
 
 //------------------------------------------------------------------------------
 // Functions
@@ -60,10 +62,13 @@ void Uart2PutString(const char* str) {
 
 void __attribute__((interrupt, auto_psv))_U2RXInterrupt(void) {
     while(U2STAbits.URXDA) {    // repeat while data available
+        if(U2STAbits.FERR) {    // framing error for character at top of FIFO
+            uart2FramingErrorCount++;
+        }
         uart2RxBuf[uart2RxBufIn] = U2RXREG; // fetch data from buffer
         uart2RxBufIn++;
         if(uart2RxBufIn == uart2RxBufOut) { // check for FIFO overrun
-            uart2RxBufOverrun = 1;
+            uart2RxOverrunCount++;
         }
     }
     _U2RXIF = 0;    // data received immediately before clearing UxRXIF will be unhandled, URXDA should be polled to set UxRXIF
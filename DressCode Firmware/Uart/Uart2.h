@@ -18,11 +18,13 @@
 extern volatile char uart2RxBuf[256];
 extern volatile unsigned char uart2RxBufIn;
 extern volatile unsigned char uart2RxBufOut;
-extern volatile int uart2RxBufOverrun;
 extern volatile char uart2TxBuf[256];
 extern volatile unsigned char uart2TxBufIn;
 extern volatile unsigned char uart2TxBufOut;
 extern volatile unsigned char uart2TxBufCount;
+extern volatile unsigned int uart2RxOverrunCount;
+extern volatile unsigned int uart2FramingErrorCount;
+extern volatile unsigned int uart2TxDroppedCount;
 
 //------------------------------------------------------------------------------
 // Function declarations
@@ -45,9 +47,18 @@ void Uart2PutString(const char* str);
         _U2TXIE = 1;                \
     }                               \
 }
-#define Uart2FlushRxBuf() { uart2RxBufOut = uart2RxBufIn; uart2RxBufOverrun = 0; }
+#define Uart2FlushRxBuf() { uart2RxBufOut = uart2RxBufIn; }
 #define Uart2FlushTxBuf() { uart2TxBufOut = uart2TxBufIn; uart2TxBufCount = 0; }
-#define Uart2RxTasks() { if(U2STAbits.URXDA) { _U2RXIF = 1; } U2STAbits.OERR = 0; }
+#define Uart2RxTasks() {            \
+    if(U2STAbits.URXDA) {           \
+        _U2RXIF = 1;                \
+    }                               \
+    if(U2STAbits.OERR) {            \
+        uart2RxOverrunCount++;      \
+        U2STAbits.OERR = 0;         \
+    }                               \
+}
+#define Uart2TxDropped(numberOfBytes) { uart2TxDroppedCount += (numberOfBytes); }
 #define Uart2TxIsIdle() (_U2TXIE != 0)
 
 #endif
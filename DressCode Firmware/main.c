@@ -9,6 +9,8 @@
     MPLAB C30 v3.31
 
     Peripherals used:
+    Timer 1                 Latency.c
+    Timer 2                 Trace.c
     Timer 5                 Delay.c
     OC 1-3                  Leds.c
     SPI 2                   AudioIn.c
@@ -23,17 +25,26 @@
     3.
     2.
     1.
+
+    UART 2 commands: see Commands.c
 */
 
 //------------------------------------------------------------------------------
 // Includes
 
+#include "AudioCapture/AudioCapture.h"
 #include "AudioIn/AudioIn.h"
+#include "Battery/Battery.h"
+#include "Commands/Commands.h"
 #include "Delay/Delay.h"
 #include "Fixed.h"
+#include "Format/Format.h"
+#include "Latency/Latency.h"
 #include "Leds/Leds.h"
 #include <p24Fxxxx.h>
-#include <stdlib.h>
+#include "Sync/Sync.h"
+#include "Telemetry/Telemetry.h"
+#include "Trace/Trace.h"
 #include "Uart/Uart2.h"
 
 //------------------------------------------------------------------------------
@@ -45,10 +56,25 @@ _FWDT(FWDTEN_OFF)       // WDT disabled in hardware; SWDTEN bit disabled
 //_FPOR(MCLRE_OFF)        // RA5 input pin enabled, MCLR disabled
 _FICD(ICS_PGx1)         // EMUC/EMUD share PGC3/PGD3
 
+//------------------------------------------------------------------------------
+// Definitions
+
+#define UART2_FLOW_CONTROL  0       // 1 if host RTS/CTS are connected to U2CTS/U2RTS, requires U2RTS_TRIS and U2CTS_TRIS
+#define TX_HIGH_WATER       192     // UART 2 TX bytes queued above which telemetry rate is reduced
+#define TX_LOW_WATER        64      // UART 2 TX bytes queued below which telemetry rate may recover
+#define RATE_HOLDOFF        256     // samples after reducing telemetry rate before reducing again
+#define RATE_RECOVERY       4032    // samples below TX_LOW_WATER before increasing telemetry rate
+
+#if UART2_FLOW_CONTROL && !(defined(U2RTS_TRIS) && defined(U2CTS_TRIS))
+#error "Define U2RTS_TRIS and U2CTS_TRIS as the TRIS bits of the U2RTS and U2CTS pins (see data sheet pin table and PCB)"
+#endif
+
 //------------------------------------------------------------------------------
 // Function declarations
 
 static void InitMain(void);
+static void TraceUartErrors(void);
+static void UpdateTelemetryRate(void);
 
 //------------------------------------------------------------------------------
 // Functions
@@ -59,54 +85,50 @@ int main(void) {
     InitMain();
 
     // Init modules
+    TraceInit();
     AudioInInit();
-    Uart2Init(UART_BAUD_250000, 0);
+    Uart2Init(UART_BAUD_250000, UART2_FLOW_CONTROL);
     LedsInit();
+    LatencyInit();
 
     // Main loop
     while(1) {
         if(AudioInIsGetReady()) {
             Fixed audioSample = AudioInGet();
+            LatencySample();
 
-            // Update LEDs
-            LedsUpdate(audioSample);
-
-            // Print audio sample
+            // Process commands
             Uart2RxTasks();
-            if(Uart2IsPutReady() >= 6) {
-                static const char asciiDigits[10] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9' };
-                int i = FIXED_TO_INT(audioSample);
-                div_t n;
-                int print = 0;
-                if(i < 0) {
-                    Uart2PutChar('-');
-                    i = -i;
-                }
-                if(i >= 10000) {
-                    n = div(i, 10000);
-                    Uart2PutChar(asciiDigits[n.quot]);
-                    i = n.rem;
-                    print = 1;
-                }
-                if(i >= 1000 || print) {
-                    n = div(i, 1000);
-                    Uart2PutChar(asciiDigits[n.quot]);
-                    i = n.rem;
-                    print = 1;
-                }
-                if(i >= 100 || print) {
-                    n = div(i, 100);
-                    Uart2PutChar(asciiDigits[n.quot]);
-                    i = n.rem;
-                    print = 1;
+            TraceUartErrors();
+            CommandsProcess();
+
+            // Update battery tier
+            BatteryUpdate();
+
+            // Update LEDs
+            int triggers = LedsDetect(audioSample, AudioInIsSilent());
+            LatencyDetect(triggers);
+            triggers = SyncUpdate(triggers);
+            LedsRender(triggers);
+            LatencyRender(triggers);
+
+            // Stream trace dump, telemetry and raw audio or print audio sample
+            TraceTasks();
+            UpdateTelemetryRate();
+            TelemetryUpdate();
+            if(AudioCaptureIsEnabled()) {
+                AudioCaptureTasks();
+            }
+            else if(!TelemetryIsEnabled()) {
+                int value = FIXED_TO_INT(audioSample);
+                int length = FormatGetIntLength(value) + 1;
+                if(Uart2IsPutReady() >= length) {
+                    FormatPutInt(value);
+                    Uart2PutChar('\r');
                 }
-                if(i >= 10 || print) {
-                    n = div(i, 10);
-                    Uart2PutChar(asciiDigits[n.quot]);
-                    i = n.rem;
+                else {
+                    Uart2TxDropped(length);
                 }
-                Uart2PutChar(asciiDigits[i]);
-                Uart2PutChar('\r');
             }
         }
     }
@@ -116,7 +138,11 @@ static void InitMain(void) {
 
     // Disable analogue Inputs
     ANSA = 0x0003;  // RA0 is Vref+, RA1 is AN1
+#if BATTERY_MONITOR
+    ANSB = 0x1000;  // RB12 is AN12 (battery voltage)
+#else
     ANSB = 0x0000;
+#endif
     ANSC = 0x0000;
 
     // Enable pull-ups
@@ -135,10 +161,67 @@ static void InitMain(void) {
     _TRISB7 = 0;    // RB7 is OC1
     _TRISC8 = 0;    // RC8 is OC2
     _TRISA10 = 0;   // RA10 is OC3
+#if UART2_FLOW_CONTROL
+    U2RTS_TRIS = 0; // U2RTS
+    U2CTS_TRIS = 1; // U2CTS
+#endif
 
     // Setup oscillator for 4 MIPS
     CLKDIVbits.RCDIV = 0b010;   // 2 MHz (divide-by-4)
 }
 
+static void TraceUartErrors(void) {
+    static unsigned int overrunCount = 0;
+    static unsigned int framingErrorCount = 0;
+    unsigned int count;
+
+    // Trace new UART 2 RX overruns and freeze trace
+    count = uart2RxOverrunCount - overrunCount;
+    if(count != 0) {
+        overrunCount += count;
+        TraceMain(TRACE_EVENT_UART_RX_OVERRUN, count > 0xFF ? 0xFF : count);
+        TraceFreezeNow(TRACE_FREEZE_UART_OVERRUN);
+    }
+
+    // Trace new UART 2 RX framing errors
+    count = uart2FramingErrorCount - framingErrorCount;
+    if(count != 0) {
+        framingErrorCount += count;
+        TraceMain(TRACE_EVENT_UART_FRAMING_ERROR, count > 0xFF ? 0xFF : count);
+    }
+}
+
+static void UpdateTelemetryRate(void) {
+    static unsigned int droppedCount = 0;
+    static unsigned int holdoff = 0;
+    static unsigned int recoveryTimer = 0;
+    int rateShift = TelemetryGetRateShift();
+
+    if(holdoff > 0) {
+        holdoff--;
+    }
+
+    // Halve telemetry rate if bytes dropped or TX buffer filling
+    if((uart2TxDroppedCount != droppedCount) || (uart2TxBufCount > TX_HIGH_WATER)) {
+        droppedCount = uart2TxDroppedCount;
+        recoveryTimer = 0;
+        if((holdoff == 0) && TelemetryIsEnabled() && (rateShift < TELEMETRY_MAX_RATE_SHIFT)) {
+            TelemetrySetRateShift(rateShift + 1);
+            holdoff = RATE_HOLDOFF;
+        }
+    }
+
+    // Double telemetry rate if TX buffer has remained nearly empty
+    else if(uart2TxBufCount < TX_LOW_WATER) {
+        if((++recoveryTimer >= RATE_RECOVERY) && (rateShift > 0)) {
+            TelemetrySetRateShift(rateShift - 1);
+            recoveryTimer = 0;
+        }
+    }
+    else {
+        recoveryTimer = 0;
+    }
+}
+
 //------------------------------------------------------------------------------
 // End of file
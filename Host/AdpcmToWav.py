@@ -0,0 +1,111 @@
+"""
+    AdpcmToWav.py
+    Author: agent
+
+    Decodes the raw audio capture stream (see AudioCapture.c) to a 16-bit mono
+    WAV file at 4032 Hz.  The input is a recording of the UART 2 byte stream,
+    or the serial port itself, e.g.:
+
+    stty -F /dev/ttyUSB0 250000 raw
+    printf C > /dev/ttyUSB0
+    python3 Host/AdpcmToWav.py /dev/ttyUSB0 capture.wav
+
+    The script stops at the end of the input or on Ctrl+C.  Packets are found by
+    searching for the sync byte and verifying the checksum (see Packet.py) so
+    that telemetry, status and other packets, and any ASCII output, are ignored.
+    Each frame carries the encoder state so every frame is decoded
+    independently.  Samples lost by the firmware (see the frame header) and
+    frames missing from the sequence are replaced by the last decoded sample
+    so that the output stays time aligned.  Time alignment is lost if the
+    firmware FIFO overruns by 256 samples or more before it is serviced, if
+    more than 65535 samples are lost between frames, or if 256 frames or more
+    are missing.
+
+    The WAV samples are the 12-bit ADC values shifted left by 4 with the most
+    significant bit inverted, i.e. ADC = (sample ^ 0x8000) >> 4.
+"""
+
+import argparse
+import struct
+import sys
+import wave
+
+import Packet
+
+SAMPLE_RATE = 4032
+FRAME_SAMPLES = 64
+HEADER_LENGTH = 6
+PAYLOAD_LENGTH = HEADER_LENGTH + FRAME_SAMPLES // 2
+
+STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41,
+    45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209,
+    230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876,
+    963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024,
+    3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493,
+    10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086,
+    29794, 32767
+]
+INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8]
+
+
+def decode_frame(payload):
+    """Returns the sequence number, lost sample count and decoded samples of a frame."""
+    sequence, lost, predictor, step_index = struct.unpack_from("<BHhB", payload)
+    step_index = min(step_index, 88)
+    samples = []
+    for byte in payload[HEADER_LENGTH:]:
+        for code in (byte & 0x0F, byte >> 4):   # first sample in the low nibble
+            step = STEP_TABLE[step_index]
+            vpdiff = step >> 3
+            if code & 4:
+                vpdiff += step
+            if code & 2:
+                vpdiff += step >> 1
+            if code & 1:
+                vpdiff += step >> 2
+            predictor += -vpdiff if code & 8 else vpdiff
+            predictor = max(-32768, min(32767, predictor))
+            step_index = max(0, min(88, step_index + INDEX_TABLE[code & 7]))
+            samples.append(predictor)
+    return sequence, lost, samples
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode DressCode IMA-ADPCM audio capture packets to WAV.")
+    parser.add_argument("input", help="recorded UART 2 stream or serial port, - for stdin")
+    parser.add_argument("output", help="WAV file")
+    arguments = parser.parse_args()
+
+    frames = 0
+    missing = 0
+    lost_samples = 0
+    last_sequence = None
+    last_sample = 0
+    stream = sys.stdin.buffer if arguments.input == "-" else open(arguments.input, "rb", buffering=0)
+    with stream, wave.open(arguments.output, "wb") as wav:
+        wav.setnchannels(1)
+        wav.setsampwidth(2)
+        wav.setframerate(SAMPLE_RATE)
+        try:
+            for packet_type, payload in Packet.read(stream):
+                if packet_type != Packet.TYPE_AUDIO_CAPTURE or len(payload) != PAYLOAD_LENGTH:
+                    continue
+                sequence, lost, samples = decode_frame(payload)
+                if last_sequence is not None:
+                    gap = (sequence - last_sequence - 1) & 0xFF
+                    if lost + gap > 0:
+                        wav.writeframes(struct.pack("<h", last_sample) * (lost + gap * FRAME_SAMPLES))
+                        missing += gap
+                        lost_samples += lost
+                last_sequence = sequence
+                last_sample = samples[-1]
+                wav.writeframes(struct.pack("<%dh" % len(samples), *samples))
+                frames += 1
+        except KeyboardInterrupt:
+            pass
+    print("%d frames decoded, %d frames missing, %d samples lost" % (frames, missing, lost_samples), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
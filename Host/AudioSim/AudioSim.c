@@ -0,0 +1,355 @@
+/*
+    AudioSim.c
+    Author: agent
+
+    Runs the firmware's audio path (AudioIn.c, Leds.c, Sync.c, Latency.c and
+    the modules that they depend on) on Linux with a simulated microphone,
+    preamp and ADC so that the auto gain, the LED thresholds, the silence gate
+    and the sound to light latency can be tested (see AudioSim.py and
+    Host/Latency.py).  Each sample, the 16 ADC buffers are written and
+    _ADC1Interrupt() is called, then the main loop runs as main.c.
+
+    The input is in ADC LSB at preamp GAIN_1 and is multiplied by the preamp
+    gain last written over SPI.  Each conversion adds ADC_NOISE of gaussian
+    noise and is rounded and clipped to 12 bits.  Conversion i of a sample is
+    taken (i + 1) / 16 of the way through the sample period and the ISR and
+    main loop run at the end of the sample period, when Timers 1, 2 and 3 are
+    set to the simulated time.  CPU time is not simulated so the ISR and the
+    main loop take no time.
+
+    Usage:
+    AudioSim [-leader] <segment>...
+
+    -leader sets sync to leader mode so that rendering is delayed as it is in
+    a group of garments.  Each segment is <input>:<seconds>[:<onset>] and the
+    segments are run in order.  Inputs:
+
+    music       white noise with a loudness that decays after a beat every
+                BEAT_PERIOD and varies randomly from beat to beat, plus the
+                preamp noise
+    loud        music at LOUD_GAIN times the level
+    silence     preamp noise only, PREAMP_NOISE
+    quiet       no preamp noise, i.e. ADC noise only
+    impulse     IMPULSE_LENGTH of IMPULSE_LEVEL
+    burst       BURST_LENGTH of a BURST_FREQ tone of BURST_LEVEL peak
+
+    An impulse or burst segment calls LatencyStart() at the start of the
+    segment, as the 'L' command does, and is quiet for STIMULUS_DELAY (for the
+    measurement to arm) plus <onset> microseconds before the stimulus.
+
+    Once per second the following is written to stdout:
+
+    second <second> <input> <led1> <led2> <led3> <silent> <gain> <thresh1> <thresh2> <thresh3>
+
+    where <led1> to <led3> are the number of samples that each LED was
+    triggered, <silent> is the number of samples that AudioIn reported
+    silence and the gain and thresholds are the values at the end of the
+    second.  At the end of each impulse or burst segment the following is
+    written:
+
+    latency <input> <crossing> <detect> <render> <pwm>
+
+    The times are in nanoseconds after the onset of the stimulus, or -1 if
+    not reached:
+
+    crossing    ISR of the sample in which Latency.c detected the ADC crossing
+    detect      main loop in which LedsDetect() first turned on an LED
+    render      main loop in which an OCxR duty cycle was first increased, i.e.
+                an LED turned on
+    pwm         start of the Timer 3 period in which that duty cycle is first
+                output
+
+    Finally, the bytes transmitted on UART 2 (e.g. the PACKET_TYPE_LATENCY
+    packets) are written in hexadecimal:
+
+    tx <byte>...
+
+    Build (from the repository root):
+    gcc -std=gnu99 -Wall -I"Host/Stub" -I"DressCode Firmware" -o AudioSim Host/AudioSim/AudioSim.c Host/Stub/Stub.c "DressCode Firmware"/{AudioCapture/AudioCapture,AudioIn/AudioIn,Battery/Battery,Latency/Latency,Leds/Leds,Packet/Packet,Sync/Sync,Telemetry/Telemetry,Trace/Trace}.c -lm
+*/
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include "AudioIn/AudioIn.h"
+#include "Battery/Battery.h"
+#include "Latency/Latency.h"
+#include "Leds/Leds.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "Sync/Sync.h"
+#include "Trace/Trace.h"
+#include "Uart/Uart2.h"
+
+//------------------------------------------------------------------------------
+// Definitions
+
+#define SAMPLE_RATE     4032
+#define SAMPLE_PERIOD_NS 248016 // 1 / 4032 Hz
+#define CONVERSIONS     16      // per sample
+#define ADC_NOISE       1.0     // LSB rms
+#define PREAMP_NOISE    0.05    // LSB rms at GAIN_1, i.e. 51 LSB at GAIN_1024
+#define MUSIC_LEVEL     8.0     // LSB rms at GAIN_1 of the loudest part of a beat
+#define BEAT_PERIOD     (SAMPLE_RATE / 2)   // samples, 120 bpm
+#define BEAT_DECAY      0.1     // seconds
+#define LOUD_GAIN       16.0
+#define STIMULUS_DELAY  1500000000LL    // ns, LATENCY_QUIET_SAMPLES plus margin
+#define IMPULSE_LEVEL   4.0     // LSB at GAIN_1
+#define IMPULSE_LENGTH  100000  // ns
+#define BURST_LEVEL     0.5     // LSB at GAIN_1, peak
+#define BURST_FREQ      1000.0  // Hz
+#define BURST_LENGTH    50000000    // ns
+#define TIMER1_TICK_NS  2000    // 500 kHz
+#define TIMER2_TICK_NS  16000   // 62.5 kHz
+#define TIMER3_TICK_NS  250     // 4 MHz, PR3 = 0xFFFF
+#define TX_BYTES_LENGTH 65536
+
+typedef enum {
+    INPUT_MUSIC,
+    INPUT_LOUD,
+    INPUT_SILENCE,
+    INPUT_QUIET,
+    INPUT_IMPULSE,
+    INPUT_BURST
+} Input;
+
+typedef struct {
+    long long crossing;
+    long long detect;
+    long long render;
+    long long pwm;
+} Timestamps;
+
+//------------------------------------------------------------------------------
+// Variables
+
+static const char* const inputNames[] = { "music", "loud", "silence", "quiet", "impulse", "burst" };
+static const double preampGains[] = { 1, 4, 16, 25, 64, 100, 256, 1024, 1 };   // indexed by PreampGain
+static volatile unsigned int* const adcBuffers[CONVERSIONS] = {
+    &ADC1BUF0, &ADC1BUF1, &ADC1BUF2, &ADC1BUF3, &ADC1BUF4, &ADC1BUF5, &ADC1BUF6, &ADC1BUF7,
+    &ADC1BUF8, &ADC1BUF9, &ADC1BUF10, &ADC1BUF11, &ADC1BUF12, &ADC1BUF13, &ADC1BUF14, &ADC1BUF15
+};
+static unsigned long long randomState = 88172645463325252ULL;
+static unsigned long sample = 0;
+static double beatLevel = 1.0;
+static long long onsetNs;
+static unsigned char txBytes[TX_BYTES_LENGTH];
+static unsigned int txCount = 0;
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+void _ADC1Interrupt(void);
+static int parseInput(const char* const name);
+static double getInput(const Input input, const long long ns, const int conversion);
+static void convert(const Input input);
+static int runMainLoop(Timestamps* const timestamps);
+static void setTimers(const long long ns);
+static long long getSampleNs(void);
+static double gaussian(void);
+static double uniform(void);
+
+//------------------------------------------------------------------------------
+// Functions
+
+int main(int argc, char* argv[]) {
+    int i;
+    unsigned int j;
+
+    if((argc >= 2) && (strcmp(argv[1], "-leader") == 0)) {
+        SyncSetMode(SYNC_MODE_LEADER);
+        argv++;
+        argc--;
+    }
+    if(argc < 2) {
+        fprintf(stderr, "Usage: AudioSim [-leader] <input>:<seconds>[:<onset>]...\n");
+        return 2;
+    }
+    TraceInit();
+    AudioInInit();
+    LedsInit();
+    LatencyInit();
+    for(i = 1; i < argc; i++) {
+        const char* const colon = strchr(argv[i], ':');
+        const int input = parseInput(argv[i]);
+        const int isStimulus = (input == INPUT_IMPULSE) || (input == INPUT_BURST);
+        Timestamps timestamps = { -1, -1, -1, -1 };
+        int seconds;
+        int second;
+        if((colon == NULL) || (input < 0)) {
+            fprintf(stderr, "Invalid segment %s\n", argv[i]);
+            return 2;
+        }
+        seconds = atoi(colon + 1);
+        if(isStimulus) {
+            const char* const onset = strchr(colon + 1, ':');
+            onsetNs = getSampleNs() + STIMULUS_DELAY + (onset != NULL ? atoll(onset + 1) * 1000LL : 0);
+            LatencyStart();
+        }
+        for(second = 0; second < seconds; second++) {
+            unsigned int ledCounts[3] = { 0, 0, 0 };
+            unsigned int silentCount = 0;
+            AudioInStatus status;
+            int k;
+            for(k = 0; k < SAMPLE_RATE; k++) {
+                int triggers;
+                convert(input);
+                triggers = runMainLoop(isStimulus ? &timestamps : NULL);
+                ledCounts[0] += (triggers & LEDS_LED1) != 0;
+                ledCounts[1] += (triggers & LEDS_LED2) != 0;
+                ledCounts[2] += (triggers & LEDS_LED3) != 0;
+                silentCount += AudioInIsSilent() != 0;
+            }
+            AudioInGetStatus(&status);
+            printf("second %lu %s %u %u %u %u %.3f %.1f %.1f %.1f\n", sample / SAMPLE_RATE - 1, inputNames[input],
+                   ledCounts[0], ledCounts[1], ledCounts[2], silentCount, FIXED_TO_FLOAT(status.gain),
+                   FIXED_TO_FLOAT(LedsGetThreshold(1)), FIXED_TO_FLOAT(LedsGetThreshold(2)),
+                   FIXED_TO_FLOAT(LedsGetThreshold(3)));
+        }
+        if(isStimulus) {
+            printf("latency %s %lld %lld %lld %lld\n", inputNames[input], timestamps.crossing, timestamps.detect,
+                   timestamps.render, timestamps.pwm);
+        }
+    }
+    printf("tx");
+    for(j = 0; j < txCount; j++) {
+        printf(" %02x", txBytes[j]);
+    }
+    printf("\n");
+    fflush(stdout);
+    return 0;
+}
+
+static int parseInput(const char* const name) {
+    int i;
+    for(i = 0; i < (int)(sizeof(inputNames) / sizeof(inputNames[0])); i++) {
+        if(strncmp(name, inputNames[i], strlen(inputNames[i])) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static double getInput(const Input input, const long long ns, const int conversion) {
+    static double value;
+    const unsigned long beatSample = sample % BEAT_PERIOD;
+    const long long stimulusNs = ns - onsetNs;
+    double level;
+    switch(input) {
+        case INPUT_MUSIC:
+        case INPUT_LOUD:
+            if(conversion == 0) {   // music and preamp noise are constant for the conversions of a sample
+                if(beatSample == 0) {
+                    beatLevel = 0.5 + uniform();  // 0.5 to 1.5
+                }
+                level = MUSIC_LEVEL * beatLevel * (0.2 + 0.8 * exp(-(double)beatSample / (BEAT_DECAY * SAMPLE_RATE)));
+                if(input == INPUT_LOUD) {
+                    level *= LOUD_GAIN;
+                }
+                value = level * gaussian() + PREAMP_NOISE * gaussian();
+            }
+            return value;
+        case INPUT_SILENCE:
+            if(conversion == 0) {
+                value = PREAMP_NOISE * gaussian();
+            }
+            return value;
+        case INPUT_IMPULSE:
+            return ((stimulusNs >= 0) && (stimulusNs < IMPULSE_LENGTH)) ? IMPULSE_LEVEL : 0.0;
+        case INPUT_BURST:
+            if((stimulusNs < 0) || (stimulusNs >= BURST_LENGTH)) {
+                return 0.0;
+            }
+            return BURST_LEVEL * sin(6.283185307 * BURST_FREQ * (double)stimulusNs * 1e-9);
+        default:
+            return 0.0;
+    }
+}
+
+static void convert(const Input input) {
+    AudioInStatus status;
+    double preampGain;
+    int i;
+    AudioInGetStatus(&status);
+    preampGain = preampGains[status.preampGain];
+    for(i = 0; i < CONVERSIONS; i++) {
+        const long long ns = getSampleNs() + ((long long)SAMPLE_PERIOD_NS * (i + 1)) / CONVERSIONS;
+        double value = floor(2048.0 + getInput(input, ns, i) * preampGain + ADC_NOISE * gaussian() + 0.5);
+        *adcBuffers[i] = value < 0.0 ? 0 : value > 4095.0 ? 4095 : (unsigned int)value;
+    }
+}
+
+static int runMainLoop(Timestamps* const timestamps) {
+    static int previousTriggers = 0;
+    const unsigned int previousDuties[3] = { OC1R, OC2R, OC3R };
+    int detectedTriggers;
+    int triggers;
+    long long ns;
+
+    // ADC interrupt at end of sequence
+    sample++;
+    ns = getSampleNs();
+    setTimers(ns);
+    _ADC1Interrupt();
+    if((timestamps != NULL) && (timestamps->crossing < 0) && (latencyState == LATENCY_STATE_CROSSED)) {
+        timestamps->crossing = ns - onsetNs;
+    }
+
+    // Main loop as main.c
+    Fixed audioSample = AudioInGet();
+    LatencySample();
+    BatteryUpdate();
+    detectedTriggers = LedsDetect(audioSample, AudioInIsSilent());
+    LatencyDetect(detectedTriggers);
+    triggers = SyncUpdate(detectedTriggers);
+    LedsRender(triggers);
+    LatencyRender(triggers);
+
+    // Timestamp first LED turned on after onset
+    if((timestamps != NULL) && (ns >= onsetNs)) {
+        if((timestamps->detect < 0) && ((detectedTriggers & ~previousTriggers) != 0)) {
+            timestamps->detect = ns - onsetNs;
+        }
+        if((timestamps->render < 0) && ((OC1R > previousDuties[0]) || (OC2R > previousDuties[1]) || (OC3R > previousDuties[2]))) {
+            timestamps->render = ns - onsetNs;
+            timestamps->pwm = timestamps->render + (long long)(PR3 - TMR3) * TIMER3_TICK_NS;
+        }
+    }
+    previousTriggers = detectedTriggers;
+
+    // Transmit
+    while(uart2TxBufCount > 0) {
+        if(txCount < TX_BYTES_LENGTH) {
+            txBytes[txCount++] = uart2TxBuf[uart2TxBufOut];
+        }
+        uart2TxBufOut++;
+        uart2TxBufCount--;
+    }
+    return detectedTriggers;
+}
+
+static void setTimers(const long long ns) {
+    TMR1 = (unsigned int)(ns / TIMER1_TICK_NS) & 0xFFFF;
+    TMR2 = (unsigned int)(ns / TIMER2_TICK_NS) & 0xFFFF;
+    TMR3 = (unsigned int)(ns / TIMER3_TICK_NS) & 0xFFFF;
+}
+
+static long long getSampleNs(void) {
+    return (long long)sample * SAMPLE_PERIOD_NS;
+}
+
+static double gaussian(void) {
+    return sqrt(-2.0 * log(1.0 - uniform())) * cos(6.283185307 * uniform());
+}
+
+static double uniform(void) {
+    randomState ^= randomState << 13;   // xorshift64
+    randomState ^= randomState >> 7;
+    randomState ^= randomState << 17;
+    return (double)(randomState >> 11) * (1.0 / 9007199254740992.0);
+}
+
+//------------------------------------------------------------------------------
+// End of file
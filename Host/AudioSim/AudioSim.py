@@ -0,0 +1,149 @@
+"""
+    AudioSim.py
+    Author: agent
+
+    Tests the auto gain, the LED thresholds and the silence gate by running
+    the firmware's audio path with a simulated microphone, preamp and ADC (see
+    AudioSim.c).
+
+    test_percentiles    each LED is triggered for (1 - percentile) of the
+                        time once the thresholds have converged, for music at
+                        two levels 24 dB apart
+    test_silence        no LEDs are triggered, the thresholds are not adapted
+                        once silence is detected and the gain is bounded, in
+                        preamp noise and in ADC noise only
+    test_recovery       the LEDs return to the target percentiles when the
+                        music resumes after silence
+    test_latency        an impulse or a tone burst after silence is detected
+                        by Latency.c within two samples of its onset, turns on
+                        an LED in the same sample and the latency packet
+                        agrees (see Host/Latency.py for the stage by stage
+                        latency)
+
+    Usage (requires gcc):
+    python3 Host/AudioSim/AudioSim.py
+"""
+
+import os
+import subprocess
+import sys
+import tempfile
+import unittest
+
+HOST_PATH = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+REPOSITORY_PATH = os.path.dirname(HOST_PATH)
+FIRMWARE_PATH = os.path.join(REPOSITORY_PATH, "DressCode Firmware")
+
+sys.path.insert(0, HOST_PATH)
+import Latency
+import Packet
+
+SAMPLE_RATE = 4032
+PERCENTILES = [0.95, 0.85, 0.6]     # see Leds.c
+MIN_THRESH = 100                    # see Leds.c
+MAX_GAIN = 2048                     # see AudioIn.c
+PERCENTILE_TOLERANCE = [0.015, 0.03, 0.05]
+CONVERGENCE = 30    # seconds
+SILENCE_DETECTION = 1   # seconds
+SAMPLE_PERIOD_NS = 248016
+PWM_PERIOD_NS = 16384000
+FIRMWARE_SOURCES = ["AudioCapture", "AudioIn", "Battery", "Latency", "Leds", "Packet", "Sync", "Telemetry", "Trace"]
+
+
+def build(directory):
+    executable = os.path.join(directory, "AudioSim")
+    subprocess.check_call(["gcc", "-std=gnu99", "-Wall", "-O2", "-I", os.path.join(HOST_PATH, "Stub"), "-I",
+                           FIRMWARE_PATH, "-o", executable, os.path.join(HOST_PATH, "AudioSim", "AudioSim.c"),
+                           os.path.join(HOST_PATH, "Stub", "Stub.c")] +
+                          [os.path.join(FIRMWARE_PATH, name, name + ".c") for name in FIRMWARE_SOURCES] + ["-lm"])
+    return executable
+
+
+def run(*segments):
+    return parse(subprocess.check_output([AudioSim.executable] + list(segments), universal_newlines=True))
+
+
+def parse(output):
+    """Returns the seconds, the latency timestamps and the bytes transmitted of the output of AudioSim."""
+    seconds = []
+    latencies = []
+    tx = b""
+    for line in output.split("\n"):
+        fields = line.split()
+        if fields and fields[0] == "second":
+            seconds.append({"input": fields[2],
+                            "leds": [int(field) / SAMPLE_RATE for field in fields[3:6]],
+                            "silent": int(fields[6]) / SAMPLE_RATE,
+                            "gain": float(fields[7]),
+                            "thresholds": [float(field) for field in fields[8:11]]})
+        elif fields and fields[0] == "latency":
+            latencies.append([int(field) for field in fields[2:6]])
+        elif fields and fields[0] == "tx":
+            tx = bytes(int(field, 16) for field in fields[1:])
+    return seconds, latencies, tx
+
+
+def mean_leds(seconds):
+    return [sum(second["leds"][led] for second in seconds) / len(seconds) for led in range(3)]
+
+
+class AudioSim(unittest.TestCase):
+    executable = None
+
+    @classmethod
+    def setUpClass(cls):
+        cls.directory = tempfile.TemporaryDirectory()
+        AudioSim.executable = build(cls.directory.name)
+
+    @classmethod
+    def tearDownClass(cls):
+        cls.directory.cleanup()
+
+    def check_percentiles(self, seconds):
+        for led, fraction in enumerate(mean_leds(seconds)):
+            self.assertAlmostEqual(fraction, 1 - PERCENTILES[led], delta=PERCENTILE_TOLERANCE[led],
+                                   msg="LED %d" % (led + 1))
+
+    def test_percentiles(self):
+        for level in ["music", "loud"]:
+            with self.subTest(level=level):
+                seconds = run(level + ":120")[0]
+                self.assertFalse(any(second["silent"] for second in seconds))
+                self.check_percentiles(seconds[CONVERGENCE:])
+
+    def test_silence(self):
+        seconds = run("music:60", "silence:60", "quiet:30")[0]
+        thresholds = seconds[60 + SILENCE_DETECTION - 1]["thresholds"]
+        for index, second in enumerate(seconds[60:]):
+            self.assertEqual(second["leds"], [0, 0, 0], msg="second %d" % (index + 60))
+            self.assertLessEqual(second["gain"], MAX_GAIN)
+            if index >= SILENCE_DETECTION:
+                self.assertEqual(second["silent"], 1)
+                self.assertEqual(second["thresholds"], thresholds)
+        self.assertTrue(all(threshold >= MIN_THRESH for threshold in thresholds))
+
+    def test_recovery(self):
+        seconds = run("music:60", "silence:30", "music:90")[0]
+        self.check_percentiles(seconds[90 + CONVERGENCE:])
+
+    def test_latency(self):
+        for stimulus in ["impulse", "burst"]:
+            for onset_us in range(0, PWM_PERIOD_NS // 1000, 4100):
+                with self.subTest(stimulus=stimulus, onset=onset_us):
+                    _, latencies, tx = run("quiet:10", "%s:2:%d" % (stimulus, onset_us))
+                    crossing, detect, render, pwm = latencies[0]
+                    self.assertTrue(0 <= crossing < 2 * SAMPLE_PERIOD_NS)
+                    self.assertEqual(detect, crossing)
+                    self.assertEqual(render, detect)
+                    self.assertTrue(render <= pwm < render + PWM_PERIOD_NS)
+                    packets = [payload for packet_type, payload in Packet.Reader().feed(tx)
+                               if packet_type == Packet.TYPE_LATENCY]
+                    self.assertEqual(len(packets), 1)
+                    status, stages = Latency.decode(packets[0])
+                    self.assertEqual(status, 0)
+                    self.assertEqual(sum(stages[1:4]), 0)
+                    self.assertAlmostEqual(stages[4], (pwm - render) / 1e6, delta=Latency.TICK_MS)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,229 @@
+/*
+    FormatBenchmark.c
+    Author: agent
+
+    Checks the output of Format.c against printf() and compares its speed with
+    the div() based integer printing that it replaced in main.c.
+
+    Every 16-bit int is checked with FormatPutInt() and FormatPutUnsigned(),
+    and their lengths with FormatGetIntLength() and FormatGetUnsignedLength(),
+    and a sweep of Fixed values spanning the full 32-bit range is checked with
+    FormatPutFixed() for 0 to FRACTION_DIGITS_MAX fractional digits.  Values
+    are limited to the 16-bit int and 32-bit Fixed ranges of the PIC24.
+
+    The PC timing does not represent the target: a PC divides in a few cycles
+    whereas the PIC24 div() is a library call around an 18 cycle REPEAT DIV.SW
+    sequence, so the div() path may even be faster on a PC.  The benchmark
+    therefore also counts the div() calls and the subtractions per value and
+    estimates PIC24 cycles from DIV_CALL_CYCLES and SUBTRACT_CYCLES.  These
+    are estimates; use the MPLAB SIM stopwatch for cycle counts on the target.
+
+    Build and run (from the repository root):
+    gcc -std=gnu99 -O2 -Wall -I"Host/Stub" -I"DressCode Firmware" -o FormatBenchmark Host/FormatBenchmark/FormatBenchmark.c Host/Stub/Stub.c "DressCode Firmware/Format/Format.c"
+    ./FormatBenchmark
+*/
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "Fixed.h"
+#include "Format/Format.h"
+#include "Uart/Uart2.h"
+
+//------------------------------------------------------------------------------
+// Definitions
+
+#define FRACTION_DIGITS_MAX 5
+#define FIXED_STEP          12345L  // Fixed sweep step, co-prime with 2^16
+#define BENCHMARK_REPEATS   50
+#define DIV_CALL_CYCLES     30      // estimated PIC24 cycles per div() call, including call and return
+#define SUBTRACT_CYCLES     4       // estimated PIC24 cycles per iteration of the subtraction loop
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+static void getOutput(char* const output);
+static void fixedToString(char* const output, const long value, const int fractionDigits);
+static void divPutInt(int i);
+static double benchmark(void (*const putInt)(const int));
+static void countOperations(double* const divCalls, double* const subtractions);
+
+//------------------------------------------------------------------------------
+// Functions
+
+int main(void) {
+    char actual[32];
+    char expected[32];
+    long mismatches = 0;
+    long checks = 0;
+    long value;
+    int fractionDigits;
+    double formatTime;
+    double divTime;
+    double divCalls;
+    double subtractions;
+
+    // Check integers
+    for(value = -32768; value <= 32767; value++) {
+        FormatPutInt((int)value);
+        getOutput(actual);
+        sprintf(expected, "%ld", value);
+        checks++;
+        if(strcmp(actual, expected) != 0) {
+            if(mismatches++ < 10) {
+                printf("FormatPutInt(%ld): \"%s\", expected \"%s\"\n", value, actual, expected);
+            }
+        }
+        checks++;
+        if(FormatGetIntLength((int)value) != (int)strlen(expected)) {
+            if(mismatches++ < 10) {
+                printf("FormatGetIntLength(%ld): %d, expected %d\n", value, FormatGetIntLength((int)value), (int)strlen(expected));
+            }
+        }
+        FormatPutUnsigned((unsigned int)(value & 0xFFFF));
+        getOutput(actual);
+        sprintf(expected, "%lu", (unsigned long)(value & 0xFFFF));
+        checks++;
+        if(strcmp(actual, expected) != 0) {
+            if(mismatches++ < 10) {
+                printf("FormatPutUnsigned(%lu): \"%s\", expected \"%s\"\n", (unsigned long)(value & 0xFFFF), actual, expected);
+            }
+        }
+        checks++;
+        if(FormatGetUnsignedLength((unsigned int)(value & 0xFFFF)) != (int)strlen(expected)) {
+            if(mismatches++ < 10) {
+                printf("FormatGetUnsignedLength(%lu): %d, expected %d\n", (unsigned long)(value & 0xFFFF),
+                       FormatGetUnsignedLength((unsigned int)(value & 0xFFFF)), (int)strlen(expected));
+            }
+        }
+    }
+
+    // Check Fixed values
+    for(fractionDigits = 0; fractionDigits <= FRACTION_DIGITS_MAX; fractionDigits++) {
+        for(value = -2147483647L - 1; value <= 2147483647L - FIXED_STEP; value += FIXED_STEP) {
+            FormatPutFixed((Fixed)value, fractionDigits);
+            getOutput(actual);
+            fixedToString(expected, value, fractionDigits);
+            checks++;
+            if(strcmp(actual, expected) != 0) {
+                if(mismatches++ < 10) {
+                    printf("FormatPutFixed(%ld, %d): \"%s\", expected \"%s\"\n", value, fractionDigits, actual, expected);
+                }
+            }
+        }
+    }
+    printf("%ld checks, %ld mismatches\n", checks, mismatches);
+
+    // Benchmark
+    formatTime = benchmark(FormatPutInt);
+    divTime = benchmark(divPutInt);
+    countOperations(&divCalls, &subtractions);
+    printf("PC time per value:      FormatPutInt %.1f ns, div() path %.1f ns\n", formatTime, divTime);
+    printf("Operations per value:   %.2f subtractions, %.2f div() calls\n", subtractions, divCalls);
+    printf("Estimated PIC24 cycles: FormatPutInt %.0f, div() path %.0f (excluding common output code)\n",
+           subtractions * SUBTRACT_CYCLES, divCalls * DIV_CALL_CYCLES);
+    return mismatches == 0 ? 0 : 1;
+}
+
+static void getOutput(char* const output) {
+    int length = 0;
+    while(uart2TxBufOut != uart2TxBufIn) {
+        output[length++] = uart2TxBuf[uart2TxBufOut++];
+    }
+    output[length] = '\0';
+    uart2TxBufCount = 0;
+}
+
+static void fixedToString(char* const output, const long value, const int fractionDigits) {
+    long long magnitude = value < 0 ? -(long long)value : value;
+    long long fraction = magnitude & 0xFFFF;
+    long long scale = 1;
+    int i;
+    for(i = 0; i < fractionDigits; i++) {
+        scale *= 10;
+    }
+    if(fractionDigits == 0) {
+        sprintf(output, "%s%lld", value < 0 ? "-" : "", magnitude >> 16);
+    }
+    else {
+        sprintf(output, "%s%lld.%0*lld", value < 0 ? "-" : "", magnitude >> 16, fractionDigits, (fraction * scale) >> 16); // truncated
+    }
+}
+
+static void divPutInt(int i) {   // as main.c before Format.c
+    static const char asciiDigits[10] = { '0', '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    div_t n;
+    int print = 0;
+    if(i < 0) {
+        Uart2PutChar('-');
+        i = -i;
+    }
+    if(i >= 10000) {
+        n = div(i, 10000);
+        Uart2PutChar(asciiDigits[n.quot]);
+        i = n.rem;
+        print = 1;
+    }
+    if(i >= 1000 || print) {
+        n = div(i, 1000);
+        Uart2PutChar(asciiDigits[n.quot]);
+        i = n.rem;
+        print = 1;
+    }
+    if(i >= 100 || print) {
+        n = div(i, 100);
+        Uart2PutChar(asciiDigits[n.quot]);
+        i = n.rem;
+        print = 1;
+    }
+    if(i >= 10 || print) {
+        n = div(i, 10);
+        Uart2PutChar(asciiDigits[n.quot]);
+        i = n.rem;
+    }
+    Uart2PutChar(asciiDigits[i]);
+}
+
+static double benchmark(void (*const putInt)(const int)) {
+    struct timespec start;
+    struct timespec end;
+    long value;
+    int repeat;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for(repeat = 0; repeat < BENCHMARK_REPEATS; repeat++) {
+        for(value = -32767; value <= 32767; value++) {  // div() path cannot print -32768 on the target
+            putInt((int)value);
+            uart2TxBufOut = uart2TxBufIn;
+            uart2TxBufCount = 0;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return ((end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec)) / (BENCHMARK_REPEATS * 65535.0);
+}
+
+static void countOperations(double* const divCalls, double* const subtractions) {
+    long divCallCount = 0;
+    long subtractionCount = 0;
+    long value;
+    for(value = -32767; value <= 32767; value++) {
+        long magnitude = labs(value);
+        long power;
+        int print = 0;
+        for(power = 10000; power >= 10; power /= 10) {
+            if(magnitude >= power || print) {
+                divCallCount++;
+                print = 1;
+            }
+            subtractionCount += (magnitude / power) % 10;
+        }
+    }
+    *divCalls = divCallCount / 65535.0;
+    *subtractions = subtractionCount / 65535.0;
+}
+
+//------------------------------------------------------------------------------
+// End of file
@@ -0,0 +1,181 @@
+"""
+    Latency.py
+    Author: agent
+
+    Prints the sound to light latency stage by stage, either as measured by a
+    device (see Latency.c) or as simulated on the PC (see AudioSim.c), e.g.:
+
+    stty -F /dev/ttyUSB0 250000 raw
+    python3 Host/Latency.py --measure /dev/ttyUSB0
+    python3 Host/Latency.py --simulate
+
+    --measure sends the 'L' command and exits after the first result, so clap
+    once the device has been quiet for 1 second.  Otherwise the input is read
+    until the end of the file (or Ctrl+C) and every result is printed.
+
+    --simulate builds AudioSim and plays an impulse and a tone burst to it
+    after silence at --runs onsets spread over a PWM period, so that the
+    phase of the sample clock and of the PWM period vary.  It prints the
+    minimum, mean and maximum of each stage as timestamped by the simulation
+    from the onset of the sound to the first OCxR write that turns on an LED,
+    then of each stage of the PACKET_TYPE_LATENCY packets that the firmware
+    sent during the same runs.  The last line is a benchmark to compare
+    between releases.  The exit status is 1 if a measurement failed or the
+    packet disagrees with the simulation.
+
+    The simulation does not model CPU time so the ADC ISR to main loop stage
+    is 0 and the stages within one sample are combined.  The device reports
+    these.  The device measures from the ADC crossing plus the constant ADC
+    averaging stage whereas the simulation measures from the onset so the
+    totals differ by the phase of the onset within the sample period.
+"""
+
+import argparse
+import os
+import struct
+import subprocess
+import sys
+import tempfile
+
+import Packet
+
+HOST_PATH = os.path.dirname(os.path.abspath(__file__))
+
+TICK_MS = 0.002     # Timer 1
+PWM_PERIOD_US = 16384   # Timer 3
+QUIET_SECONDS = 10  # for the auto gain to reach silence
+STIMULUS_SECONDS = 2    # see STIMULUS_DELAY in AudioSim.c
+STIMULI = ["impulse", "burst"]
+
+STATUSES = ["successful", "no LED turned on", "not quiet", "no sound"]
+STAGES = ["ADC averaging", "ADC ISR to main loop", "Main loop to LED trigger", "LED trigger to OC write",
+          "OC write to PWM", "Total"]
+SIMULATED_STAGES = ["Sound to ADC crossing", "ADC crossing to LED trigger", "LED trigger to OC write",
+                    "OC write to PWM", "Total"]
+
+
+def decode(payload):
+    """Returns the status and the stages in milliseconds of a latency packet."""
+    if len(payload) != 13:
+        raise ValueError("latency packet length is not 13")
+    status = payload[0]
+    stages = [ticks * TICK_MS for ticks in struct.unpack_from("<6H", payload, 1)]
+    return status, stages
+
+
+def status_text(status):
+    return STATUSES[status] if status < len(STATUSES) else str(status)
+
+
+def print_result(status, stages):
+    if status != 0:
+        print("Latency measurement failed: %s" % status_text(status))
+        return
+    for stage, milliseconds in zip(STAGES, stages):
+        print("%-28s %7.3f ms" % (stage, milliseconds))
+
+
+def simulate(executable, stimulus, onset_us, leader):
+    """Returns the simulated stages in milliseconds and the decoded packet of one run."""
+    arguments = [executable] + (["-leader"] if leader else []) + \
+                ["quiet:%d" % QUIET_SECONDS, "%s:%d:%d" % (stimulus, STIMULUS_SECONDS, onset_us)]
+    output = subprocess.check_output(arguments, universal_newlines=True)
+    simulated = None
+    packet = None
+    for line in output.split("\n"):
+        fields = line.split()
+        if fields and fields[0] == "latency":
+            crossing, detect, render, pwm = [int(field) / 1e6 for field in fields[2:6]]
+            if min(crossing, detect, render, pwm) >= 0:
+                simulated = [crossing, detect - crossing, render - detect, pwm - render, pwm]
+        elif fields and fields[0] == "tx":
+            for packet_type, payload in Packet.Reader().feed(bytes(int(field, 16) for field in fields[1:])):
+                if packet_type == Packet.TYPE_LATENCY:
+                    packet = decode(payload)
+    return simulated, packet
+
+
+def summary_lines(names, runs):
+    """Returns lines of the minimum, mean and maximum of each stage, runs maps stimulus to a list of stages."""
+    lines = [("%-28s" % "" + "".join("%-24s" % stimulus for stimulus in runs)).rstrip(),
+             ("%-28s" % "Stage (ms)" + "   min    mean    max   " * len(runs)).rstrip()]
+    for index, name in enumerate(names):
+        line = "%-28s" % name
+        for stages in runs.values():
+            values = [run[index] for run in stages]
+            line += "%6.3f %7.3f %6.3f   " % (min(values), sum(values) / len(values), max(values))
+        lines.append(line.rstrip())
+    return lines
+
+
+def run_simulation(count, leader):
+    sys.path.insert(0, os.path.join(HOST_PATH, "AudioSim"))
+    import AudioSim
+    simulated = {stimulus: [] for stimulus in STIMULI}
+    packets = {stimulus: [] for stimulus in STIMULI}
+    failures = 0
+    with tempfile.TemporaryDirectory() as directory:
+        executable = AudioSim.build(directory)
+        for stimulus in STIMULI:
+            for run in range(count):
+                onset_us = run * PWM_PERIOD_US // count
+                stages, packet = simulate(executable, stimulus, onset_us, leader)
+                if (stages is None) or (packet is None) or (packet[0] != 0):
+                    print("%s at %d us: no LED turned on or %s" %
+                          (stimulus, onset_us, status_text(packet[0]) if packet else "no packet"))
+                    failures += 1
+                    continue
+                packet_stages = packet[1]
+                if (abs(sum(packet_stages[1:4]) - (stages[1] + stages[2])) > TICK_MS) or \
+                        (abs(packet_stages[4] - stages[3]) > TICK_MS):
+                    print("%s at %d us: packet %s disagrees with simulation %s" %
+                          (stimulus, onset_us, packet_stages, stages))
+                    failures += 1
+                simulated[stimulus].append(stages)
+                packets[stimulus].append(packet_stages)
+    if not all(simulated.values()):
+        return 1
+    print("Simulated, %d onsets, sync %s" % (count, "leader" if leader else "off"))
+    print("\n".join(summary_lines(SIMULATED_STAGES, simulated)) + "\n")
+    print("Latency packets sent by the simulated firmware")
+    print("\n".join(summary_lines(STAGES, packets)) + "\n")
+    print("Benchmark: " + ", ".join("%s %.3f ms mean sound to light" %
+                                    (stimulus, sum(run[-1] for run in runs) / len(runs))
+                                    for stimulus, runs in simulated.items()))
+    return 1 if failures else 0
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Print the DressCode sound to light latency.")
+    parser.add_argument("input", nargs="?", help="recorded UART 2 stream or serial port, - for stdin")
+    parser.add_argument("--measure", action="store_true", help="send 'L' to the serial port and exit after one result")
+    parser.add_argument("--simulate", action="store_true", help="simulate on the PC (requires gcc)")
+    parser.add_argument("--runs", type=int, default=16, help="onsets per stimulus for --simulate")
+    parser.add_argument("--leader", action="store_true", help="simulate in sync leader mode")
+    arguments = parser.parse_args()
+
+    if arguments.simulate:
+        sys.exit(run_simulation(arguments.runs, arguments.leader))
+    if arguments.input is None:
+        parser.error("input is required unless --simulate")
+
+    if arguments.input == "-":
+        stream = sys.stdin.buffer
+    else:
+        stream = open(arguments.input, "r+b" if arguments.measure else "rb", buffering=0)
+    if arguments.measure:
+        stream.write(b"L")
+    try:
+        for packet_type, payload in Packet.read(stream):
+            if packet_type != Packet.TYPE_LATENCY:
+                continue
+            print_result(*decode(payload))
+            if arguments.measure:
+                break
+            print()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
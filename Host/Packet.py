@@ -0,0 +1,70 @@
+"""
+    Packet.py
+    Author: agent
+
+    Encodes and decodes the binary packets sent over UART 2 (see Packet.c).
+
+    Bytes are not escaped so Reader resynchronises by searching for SYNC and
+    discarding a single byte whenever a candidate packet has an invalid
+    checksum.  Bytes outside packets (e.g. the ASCII audio samples printed when
+    no stream is enabled) are counted in Reader.discarded.
+"""
+
+SYNC = 0x7E
+OVERHEAD = 4    # sync, type, length and checksum bytes
+
+TYPE_AUDIO_CAPTURE = 0x01
+TYPE_TELEMETRY = 0x02
+TYPE_SYNC = 0x03
+TYPE_STATUS = 0x04
+TYPE_LATENCY = 0x05
+TYPE_TRACE = 0x06
+
+
+def encode(packet_type, payload):
+    body = bytes([packet_type, len(payload)]) + bytes(payload)
+    return bytes([SYNC]) + body + bytes([-sum(body) & 0xFF])
+
+
+class Reader:
+    def __init__(self):
+        self.buffer = bytearray()
+        self.discarded = 0  # bytes outside packets
+        self.invalid = 0    # candidate packets with an invalid checksum
+
+    def feed(self, data):
+        """Adds received bytes and returns a list of (type, payload) tuples."""
+        self.buffer += data
+        packets = []
+        while True:
+            start = self.buffer.find(SYNC)
+            if start < 0:
+                self.discarded += len(self.buffer)
+                del self.buffer[:]
+                return packets
+            self.discarded += start
+            del self.buffer[:start]
+            if len(self.buffer) < 3:
+                return packets
+            length = self.buffer[2]
+            if len(self.buffer) < length + OVERHEAD:
+                return packets
+            if sum(self.buffer[1:length + OVERHEAD]) & 0xFF != 0:
+                self.invalid += 1
+                self.discarded += 1
+                del self.buffer[:1]     # discard sync byte
+                continue
+            packets.append((self.buffer[1], bytes(self.buffer[3:3 + length])))
+            del self.buffer[:length + OVERHEAD]
+
+
+def read(stream, chunk_size=4096):
+    """Yields (type, payload) tuples from a binary file object until EOF."""
+    reader = Reader()
+    read_chunk = getattr(stream, "read1", stream.read)  # do not wait for a full chunk from a serial port
+    while True:
+        data = read_chunk(chunk_size)
+        if not data:
+            return
+        for packet in reader.feed(data):
+            yield packet
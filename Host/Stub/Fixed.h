@@ -0,0 +1,12 @@
+/*
+    Fixed.h
+    Author: agent
+
+    The firmware includes "Fixed.h" but the file is named fixed.h, which only
+    resolves on a case-insensitive file system.
+*/
+
+#include "fixed.h"
+
+//------------------------------------------------------------------------------
+// End of file
@@ -0,0 +1,96 @@
+/*
+    Stub.c
+    Author: agent
+
+    Defines the registers declared by p24Fxxxx.h and replaces the UART 2
+    driver (Uart2.c) with its buffers.  Host programs move bytes between the
+    buffers and the outside world themselves.
+
+    _RC0 (battery charging status, active low) is initialised to 1, not
+    charging.  All other registers are initialised to 0.
+*/
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include <p24Fxxxx.h>
+#include "Uart/Uart2.h"
+
+//------------------------------------------------------------------------------
+// Variables
+
+volatile unsigned int AD1CON1;
+volatile StubBits AD1CON1bits;
+volatile StubBits AD1CON2bits;
+volatile StubBits AD1CON3bits;
+volatile StubBits AD1CHSbits;
+volatile unsigned int ADC1BUF0;
+volatile unsigned int ADC1BUF1;
+volatile unsigned int ADC1BUF2;
+volatile unsigned int ADC1BUF3;
+volatile unsigned int ADC1BUF4;
+volatile unsigned int ADC1BUF5;
+volatile unsigned int ADC1BUF6;
+volatile unsigned int ADC1BUF7;
+volatile unsigned int ADC1BUF8;
+volatile unsigned int ADC1BUF9;
+volatile unsigned int ADC1BUF10;
+volatile unsigned int ADC1BUF11;
+volatile unsigned int ADC1BUF12;
+volatile unsigned int ADC1BUF13;
+volatile unsigned int ADC1BUF14;
+volatile unsigned int ADC1BUF15;
+volatile StubBits OC1CON1bits;
+volatile StubBits OC1CON2bits;
+volatile StubBits OC2CON1bits;
+volatile StubBits OC2CON2bits;
+volatile StubBits OC3CON1bits;
+volatile StubBits OC3CON2bits;
+volatile unsigned int OC1R;
+volatile unsigned int OC2R;
+volatile unsigned int OC3R;
+volatile unsigned int SPI2BUF;
+volatile StubBits SPI2CON1bits;
+volatile StubBits SPI2STATbits;
+volatile StubBits T1CONbits;
+volatile StubBits T2CONbits;
+volatile StubBits T3CONbits;
+volatile unsigned int PR1;
+volatile unsigned int PR2;
+volatile unsigned int PR3;
+volatile unsigned int TMR1;
+volatile unsigned int TMR2;
+volatile unsigned int TMR3;
+volatile StubBits U2STAbits;
+volatile unsigned int _AD1IE;
+volatile unsigned int _AD1IF;
+volatile unsigned int _AD1IP;
+volatile unsigned int _LATA9;
+volatile unsigned int _RC0 = 1;
+volatile unsigned int _U2RXIF;
+volatile unsigned int _U2TXIE;
+volatile unsigned int _U2TXIF;
+
+volatile char uart2RxBuf[256];
+volatile unsigned char uart2RxBufIn = 0;
+volatile unsigned char uart2RxBufOut = 0;
+volatile char uart2TxBuf[256];
+volatile unsigned char uart2TxBufIn = 0;
+volatile unsigned char uart2TxBufOut = 0;
+volatile unsigned char uart2TxBufCount = 0;
+volatile unsigned int uart2RxOverrunCount = 0;
+volatile unsigned int uart2FramingErrorCount = 0;
+volatile unsigned int uart2TxDroppedCount = 0;
+
+static volatile unsigned int spi2If;
+
+//------------------------------------------------------------------------------
+// Functions
+
+volatile unsigned int* StubSpi2If(void) {
+    spi2If = 1; // transfer complete, a write through the pointer overrides
+    return &spi2If;
+}
+
+//------------------------------------------------------------------------------
+// End of file
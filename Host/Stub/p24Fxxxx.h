@@ -0,0 +1,123 @@
+/*
+    p24Fxxxx.h
+    Author: agent
+
+    Stand-in for the MPLAB C30 device header so that the firmware modules can
+    be compiled and tested on a PC.  Only the registers referenced by the
+    modules other than main.c, Delay.c and the UART drivers are declared.
+    Stub.c defines the registers and the UART 2 buffers, and host programs
+    drive the registers (e.g. TMR1, ADC1BUFx) to simulate the hardware.
+
+    Differences from the target:
+    - int is 32-bit and long (Fixed) is 64-bit.  Modules mask 16-bit timer
+      arithmetic where this matters.
+    - SPI transfers complete immediately: reading _SPI2IF always returns 1
+      after it is written.
+    - The interrupt attributes are ignored; host programs call ISRs directly.
+*/
+
+#ifndef p24Fxxxx_h
+#define p24Fxxxx_h
+
+//------------------------------------------------------------------------------
+// Definitions
+
+typedef struct {
+    unsigned ADCS : 8;
+    unsigned ADON : 1;
+    unsigned ALTS : 1;
+    unsigned ASAM : 1;
+    unsigned CH0SA : 5;
+    unsigned CH0SB : 5;
+    unsigned CKE : 1;
+    unsigned MODE16 : 1;
+    unsigned MSTEN : 1;
+    unsigned OCM : 3;
+    unsigned OCTSEL : 3;
+    unsigned OERR : 1;
+    unsigned PPRE : 2;
+    unsigned PVCFG : 2;
+    unsigned SAMC : 5;
+    unsigned SISEL : 3;
+    unsigned SMPI : 5;
+    unsigned SPIEN : 1;
+    unsigned SPRE : 3;
+    unsigned SSRC : 4;
+    unsigned SYNCSEL : 5;
+    unsigned TCKPS : 2;
+    unsigned TON : 1;
+    unsigned URXDA : 1;
+} StubBits;
+
+#define interrupt   unused  // see __attribute__((interrupt, auto_psv))
+#define auto_psv    unused
+
+//------------------------------------------------------------------------------
+// Variable declarations
+
+extern volatile unsigned int AD1CON1;
+extern volatile StubBits AD1CON1bits;
+extern volatile StubBits AD1CON2bits;
+extern volatile StubBits AD1CON3bits;
+extern volatile StubBits AD1CHSbits;
+extern volatile unsigned int ADC1BUF0;
+extern volatile unsigned int ADC1BUF1;
+extern volatile unsigned int ADC1BUF2;
+extern volatile unsigned int ADC1BUF3;
+extern volatile unsigned int ADC1BUF4;
+extern volatile unsigned int ADC1BUF5;
+extern volatile unsigned int ADC1BUF6;
+extern volatile unsigned int ADC1BUF7;
+extern volatile unsigned int ADC1BUF8;
+extern volatile unsigned int ADC1BUF9;
+extern volatile unsigned int ADC1BUF10;
+extern volatile unsigned int ADC1BUF11;
+extern volatile unsigned int ADC1BUF12;
+extern volatile unsigned int ADC1BUF13;
+extern volatile unsigned int ADC1BUF14;
+extern volatile unsigned int ADC1BUF15;
+extern volatile StubBits OC1CON1bits;
+extern volatile StubBits OC1CON2bits;
+extern volatile StubBits OC2CON1bits;
+extern volatile StubBits OC2CON2bits;
+extern volatile StubBits OC3CON1bits;
+extern volatile StubBits OC3CON2bits;
+extern volatile unsigned int OC1R;
+extern volatile unsigned int OC2R;
+extern volatile unsigned int OC3R;
+extern volatile unsigned int SPI2BUF;
+extern volatile StubBits SPI2CON1bits;
+extern volatile StubBits SPI2STATbits;
+extern volatile StubBits T1CONbits;
+extern volatile StubBits T2CONbits;
+extern volatile StubBits T3CONbits;
+extern volatile unsigned int PR1;
+extern volatile unsigned int PR2;
+extern volatile unsigned int PR3;
+extern volatile unsigned int TMR1;
+extern volatile unsigned int TMR2;
+extern volatile unsigned int TMR3;
+extern volatile StubBits U2STAbits;
+extern volatile unsigned int _AD1IE;
+extern volatile unsigned int _AD1IF;
+extern volatile unsigned int _AD1IP;
+extern volatile unsigned int _LATA9;
+extern volatile unsigned int _RC0;
+extern volatile unsigned int _U2RXIF;
+extern volatile unsigned int _U2TXIE;
+extern volatile unsigned int _U2TXIF;
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+volatile unsigned int* StubSpi2If(void);
+
+//------------------------------------------------------------------------------
+// Macros
+
+#define _SPI2IF (*StubSpi2If())
+
+#endif
+
+//------------------------------------------------------------------------------
+// End of file
@@ -0,0 +1,216 @@
+/*
+    SyncHarness.c
+    Author: agent
+
+    Runs the firmware's command parser (Commands.c), Packet.c, Sync.c,
+    Telemetry.c and the modules that they depend on on Linux so that the sync
+    protocol can be tested over a pseudo-terminal (see SyncPty.py).  The UART 2
+    driver is replaced by copying bytes between the RX and TX buffers and a
+    file descriptor.  Received bytes are read once per audio sample (248 us),
+    as the main loop does.  Each TX byte is written when it would finish
+    transmitting at 250 kbaud (40 us per byte) so that the TX buffer fills as
+    it does on the target and the leader's latency compensation is exercised.
+
+    Usage:
+    SyncHarness leader <fd> <samples> [<start>]
+    SyncHarness follower <fd> <samples> [<start>]
+
+    <start> is the CLOCK_MONOTONIC time (ns) of the first sample so that the
+    phase of the sample clocks of two harnesses can be set.  The default is
+    now.
+
+    Each sample, both parse received bytes with CommandsProcess() as main.c
+    does.  The leader sends triggers that increment every TRIGGER_PERIOD
+    samples and streams telemetry so that the number of
+    bytes queued ahead of each sync packet varies.  The follower starts with
+    sync off and its own triggers are always 0.  Both write to stdout:
+
+    mode <sample> <mode>                when the sync mode changes
+    render <sample> <ns> <triggers>     when the rendered triggers change, ns is
+                                        CLOCK_MONOTONIC time of the sample
+    capture <sample> <enabled>          when audio capture is started or stopped
+    events <sample> <mask>              when the trace event mask changes
+    freeze <sample> <reason>            when the trace freezes or resumes
+
+    Build (from the repository root):
+    gcc -std=gnu99 -Wall -I"Host/Stub" -I"DressCode Firmware" -o SyncHarness Host/SyncPty/SyncHarness.c Host/Stub/Stub.c "DressCode Firmware"/{AudioCapture/AudioCapture,AudioIn/AudioIn,Battery/Battery,Commands/Commands,Latency/Latency,Leds/Leds,Packet/Packet,Sync/Sync,Telemetry/Telemetry,Trace/Trace}.c
+*/
+
+//------------------------------------------------------------------------------
+// Includes
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "AudioCapture/AudioCapture.h"
+#include "Commands/Commands.h"
+#include "Leds/Leds.h"
+#include "Sync/Sync.h"
+#include "Telemetry/Telemetry.h"
+#include "Trace/Trace.h"
+#include "Uart/Uart2.h"
+
+//------------------------------------------------------------------------------
+// Definitions
+
+#define SAMPLE_PERIOD_NS    248016  // 4032 Hz
+#define BYTE_PERIOD_NS      40000   // 10 bits at 250 kbaud
+#define TRIGGER_PERIOD      50      // samples
+
+//------------------------------------------------------------------------------
+// Variables
+
+static int fd;
+static int isTxBusy = 0;
+static long long txDoneNs;  // time at which the byte being transmitted is complete
+
+//------------------------------------------------------------------------------
+// Function declarations
+
+static int receive(void);
+static void transmit(const long long sampleNs, const long long nextSampleNs);
+static long long toNs(const struct timespec* const time);
+static void sleepUntil(const long long ns);
+
+//------------------------------------------------------------------------------
+// Functions
+
+int main(int argc, char* argv[]) {
+    int isLeader;
+    unsigned long samples;
+    unsigned long sample;
+    int rendered = 0;
+    SyncMode mode = SYNC_MODE_OFF;
+    int capture = 0;
+    unsigned int events = traceEvents;
+    TraceFreeze freeze = TRACE_FREEZE_NONE;
+    long long sampleNs;
+
+    if((argc != 4) && (argc != 5)) {
+        fprintf(stderr, "Usage: %s leader|follower <fd> <samples> [<start>]\n", argv[0]);
+        return 2;
+    }
+    isLeader = strcmp(argv[1], "leader") == 0;
+    fd = atoi(argv[2]);
+    samples = strtoul(argv[3], NULL, 10);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+
+    TraceInit();
+    if(isLeader) {
+        SyncSetMode(SYNC_MODE_LEADER);
+        TelemetrySetChannel(TELEMETRY_CHANNEL_ENVELOPE, 4);
+        TelemetrySetChannel(TELEMETRY_CHANNEL_ADC, 7);
+    }
+    if(argc == 5) {
+        sampleNs = strtoll(argv[4], NULL, 10);
+        sleepUntil(sampleNs);
+    }
+    else {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        sampleNs = toNs(&now);
+    }
+    for(sample = 0; sample < samples; sample++) {
+        int triggers;
+
+        // Main loop as main.c
+        if(receive() != 0) {
+            break;  // other end closed
+        }
+        CommandsProcess();
+        triggers = isLeader ? (int)(sample / TRIGGER_PERIOD) & (LEDS_LED1 | LEDS_LED2 | LEDS_LED3) : 0;
+        triggers = SyncUpdate(triggers);
+        TraceTasks();
+        TelemetryUpdate();
+        if(AudioCaptureIsEnabled()) {
+            AudioCaptureTasks();
+        }
+
+        // Report state changes
+        if(SyncGetMode() != mode) {
+            mode = SyncGetMode();
+            printf("mode %lu %d\n", sample, mode);
+        }
+        if(triggers != rendered) {
+            rendered = triggers;
+            printf("render %lu %lld %d\n", sample, sampleNs, triggers);
+        }
+        if(AudioCaptureIsEnabled() != capture) {
+            capture = AudioCaptureIsEnabled();
+            printf("capture %lu %d\n", sample, capture);
+        }
+        if(traceEvents != events) {
+            events = traceEvents;
+            printf("events %lu %u\n", sample, events);
+        }
+        if(traceFreeze != freeze) {
+            freeze = traceFreeze;
+            printf("freeze %lu %d\n", sample, freeze);
+        }
+
+        // Transmit until next sample
+        transmit(sampleNs, sampleNs + SAMPLE_PERIOD_NS);
+        sampleNs += SAMPLE_PERIOD_NS;
+        sleepUntil(sampleNs);
+    }
+    fflush(stdout);
+    return 0;
+}
+
+static int receive(void) {
+    char buffer[256];
+    unsigned int space = 255 - (unsigned char)Uart2IsGetReady();
+    ssize_t count;
+    ssize_t i;
+    if(space == 0) {
+        return 0;
+    }
+    count = read(fd, buffer, space);
+    if(count < 0) {
+        return (errno == EAGAIN) ? 0 : 1;
+    }
+    if(count == 0) {
+        return 1;
+    }
+    for(i = 0; i < count; i++) {
+        uart2RxBuf[uart2RxBufIn++] = buffer[i];
+    }
+    return 0;
+}
+
+static void transmit(const long long sampleNs, const long long nextSampleNs) {
+    while(uart2TxBufCount > 0) {
+        char byte = uart2TxBuf[uart2TxBufOut];
+        if(!isTxBusy) {
+            txDoneNs = sampleNs + BYTE_PERIOD_NS; // bytes queued this sample start now
+            isTxBusy = 1;
+        }
+        if(txDoneNs > nextSampleNs) {
+            return; // byte completes after next sample
+        }
+        sleepUntil(txDoneNs);
+        if(write(fd, &byte, 1) != 1) {
+            return; // retry next sample
+        }
+        uart2TxBufOut++;
+        uart2TxBufCount--;
+        txDoneNs += BYTE_PERIOD_NS;
+    }
+    isTxBusy = 0;
+}
+
+static long long toNs(const struct timespec* const time) {
+    return (long long)time->tv_sec * 1000000000LL + time->tv_nsec;
+}
+
+static void sleepUntil(const long long ns) {
+    struct timespec time = { .tv_sec = ns / 1000000000LL, .tv_nsec = ns % 1000000000LL };
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, NULL);
+}
+
+//------------------------------------------------------------------------------
+// End of file
@@ -0,0 +1,208 @@
+"""
+    SyncPty.py
+    Author: agent
+
+    Tests the sync protocol on Linux by running the firmware's command parser,
+    Packet.c and Sync.c (see SyncHarness.c) on each end of a pseudo-terminal
+    pair.
+
+    test_leader     leader sync packets are valid, sequential and carry the
+                    triggers amongst telemetry packets
+    test_follower   follower enters follower mode on the first sync packet,
+                    renders sync packets, consumes foreign packets in full,
+                    recovers from corrupt and truncated packets, ignores
+                    commands and reverts to off when the leader is lost
+    test_link       follower renders the same trigger sequence as the leader
+                    and at the same time as the leader's delayed rendering,
+                    within LINK_TOLERANCE, while the leader streams telemetry
+    test_commands   commands received while sync is off change the state
+
+    Usage (requires gcc):
+    python3 Host/SyncPty/SyncPty.py
+"""
+
+import os
+import subprocess
+import sys
+import tempfile
+import time
+import tty
+import unittest
+
+HOST_PATH = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+REPOSITORY_PATH = os.path.dirname(HOST_PATH)
+FIRMWARE_PATH = os.path.join(REPOSITORY_PATH, "DressCode Firmware")
+
+sys.path.insert(0, HOST_PATH)
+import Packet
+
+SAMPLE_RATE = 4032
+TRIGGER_PERIOD = 50     # see SyncHarness.c
+LATENCY_SAMPLES = 8     # see Sync.c
+INCOMPLETE_TIMEOUT = 403    # see Packet.c
+FOLLOWER_TIMEOUT = 4032     # see Sync.c
+SYNC_MODE_OFF = 0
+SYNC_MODE_FOLLOWER = 2
+TRIGGERS_MASK = 0x07
+SAMPLE_PERIOD_NS = 248016
+LINK_TOLERANCE = 1.0 / SAMPLE_RATE  # seconds, follower sample clock lags by half a sample
+FIRMWARE_SOURCES = ["AudioCapture", "AudioIn", "Battery", "Commands", "Latency", "Leds", "Packet", "Sync", "Telemetry",
+                    "Trace"]
+
+
+def build(directory):
+    executable = os.path.join(directory, "SyncHarness")
+    subprocess.check_call(["gcc", "-std=gnu99", "-Wall", "-I", os.path.join(HOST_PATH, "Stub"), "-I", FIRMWARE_PATH,
+                           "-o", executable, os.path.join(HOST_PATH, "SyncPty", "SyncHarness.c"),
+                           os.path.join(HOST_PATH, "Stub", "Stub.c")] +
+                          [os.path.join(FIRMWARE_PATH, name, name + ".c") for name in FIRMWARE_SOURCES])
+    return executable
+
+
+def start(mode, fd, samples, start_ns=None):
+    arguments = [SyncPty.executable, mode, str(fd), str(samples)] + ([str(start_ns)] if start_ns is not None else [])
+    return subprocess.Popen(arguments, pass_fds=[fd],
+                            stdout=subprocess.PIPE, universal_newlines=True)
+
+
+def expected_triggers(samples):
+    triggers = [(sample // TRIGGER_PERIOD) & TRIGGERS_MASK for sample in range(samples)]
+    return [t for i, t in enumerate(triggers) if i > 0 and t != triggers[i - 1]]
+
+
+def lines(output, name):
+    return [[int(field) for field in line.split()[1:]] for line in output.split("\n") if line.startswith(name + " ")]
+
+
+def sync_packet(sequence, triggers, delay=0):
+    return Packet.encode(Packet.TYPE_SYNC, [sequence & 0xFF, triggers, delay])
+
+
+class SyncPty(unittest.TestCase):
+    executable = None
+
+    def setUp(self):
+        self.master, self.slave = os.openpty()
+        tty.setraw(self.slave)
+
+    def tearDown(self):
+        for fd in (self.master, self.slave):
+            try:
+                os.close(fd)
+            except OSError:
+                pass
+
+    def test_leader(self):
+        samples = 2 * SAMPLE_RATE
+        leader = start("leader", self.slave, samples)
+        os.set_blocking(self.master, False)
+        reader = Packet.Reader()
+        packets = []
+        while leader.poll() is None:
+            time.sleep(0.01)
+            try:
+                packets += reader.feed(os.read(self.master, 4096))
+            except BlockingIOError:
+                pass
+        leader.communicate()
+        time.sleep(0.05)
+        try:
+            packets += reader.feed(os.read(self.master, 4096))
+        except BlockingIOError:
+            pass
+
+        self.assertEqual(reader.invalid, 0)
+        self.assertEqual(reader.discarded, 0)
+        triggers = []
+        sync_packets = [payload for packet_type, payload in packets if packet_type == Packet.TYPE_SYNC]
+        self.assertIn(Packet.TYPE_TELEMETRY, [packet_type for packet_type, _ in packets])
+        delays = set()
+        for index, payload in enumerate(sync_packets):
+            self.assertEqual(len(payload), 3)
+            self.assertEqual(payload[0], index & 0xFF)  # sequence
+            self.assertLessEqual(payload[2], LATENCY_SAMPLES)
+            delays.add(payload[2])
+            if not triggers or payload[1] != triggers[-1]:
+                triggers.append(payload[1])
+        self.assertEqual(triggers[1:], expected_triggers(samples))  # first packet is the initial triggers
+        self.assertGreater(len(delays), 1)  # compensation varies with bytes queued by telemetry
+
+    def test_follower(self):
+        follower = start("follower", self.slave, 10 * SAMPLE_RATE)
+        foreign = Packet.encode(Packet.TYPE_TELEMETRY, b"LCT~tcSDRE\x7e\x03\x03" * 4)
+        too_long = Packet.encode(Packet.TYPE_TRACE, bytes(range(200)))
+        corrupt = bytes([Packet.SYNC, Packet.TYPE_SYNC, 3, 0, 1, 0, 0xFF])
+        truncated = bytes([Packet.SYNC, Packet.TYPE_TELEMETRY, 50, 1, 2])
+
+        def send(data, wait=0.02):
+            os.write(self.master, data)
+            time.sleep(wait)
+
+        send(sync_packet(0, 1))
+        send(foreign)
+        send(sync_packet(1, 2))
+        send(too_long[:100])
+        send(too_long[100:])
+        send(sync_packet(2, 3))
+        send(corrupt)
+        send(sync_packet(3, 4))
+        send(truncated, 2 * INCOMPLETE_TIMEOUT / SAMPLE_RATE)
+        send(b"S\x01CDE\xff\xff")   # commands that would change state if not ignored
+        send(sync_packet(4, 5), 1.5 * FOLLOWER_TIMEOUT / SAMPLE_RATE)
+        os.close(self.master)
+        output = follower.communicate()[0]
+
+        self.assertEqual([mode for _, mode in lines(output, "mode")], [SYNC_MODE_FOLLOWER, SYNC_MODE_OFF])
+        self.assertEqual([triggers for _, _, triggers in lines(output, "render")], [1, 2, 3, 4, 5, 0])  # 0 when off
+        for name in ("capture", "events", "freeze"):    # corrupt, truncated and commands ignored
+            self.assertEqual(lines(output, name), [])
+
+    def test_link(self):
+        samples = 2 * SAMPLE_RATE
+        start_ns = time.clock_gettime_ns(time.CLOCK_MONOTONIC) + 100000000
+        follower = start("follower", self.slave, samples + SAMPLE_RATE, start_ns + SAMPLE_PERIOD_NS // 2)
+        leader = start("leader", self.master, samples, start_ns)
+        leader_renders = lines(leader.communicate()[0], "render")
+        time.sleep(0.1)
+        os.close(self.master)
+        follower_renders = lines(follower.communicate()[0], "render")
+
+        self.assertEqual([triggers for _, _, triggers in follower_renders], expected_triggers(samples))
+        self.assertEqual([triggers for _, _, triggers in leader_renders], expected_triggers(samples))
+        errors = [(follower_ns - leader_ns) / 1e9 for (_, follower_ns, _), (_, leader_ns, _) in
+                  zip(follower_renders, leader_renders)]
+        errors.sort()
+        print("\nfollower render time - leader render time: min %+.3f ms, median %+.3f ms, max %+.3f ms" %
+              (errors[0] * 1e3, errors[len(errors) // 2] * 1e3, errors[-1] * 1e3))
+        self.assertLess(abs(errors[len(errors) // 2]), 0.5 / SAMPLE_RATE + 0.1e-3)  # half a sample, 0.1 ms jitter
+        within = [error for error in errors if abs(error) < LINK_TOLERANCE]
+        self.assertGreaterEqual(len(within), 0.95 * len(errors))   # allow for scheduling delays
+
+    def test_commands(self):
+        device = start("follower", self.slave, 10 * SAMPLE_RATE)
+        os.set_blocking(self.master, False)
+
+        def send(data, wait=0.02):
+            os.write(self.master, data)
+            time.sleep(wait)
+
+        send(b"E")                  # arguments arrive later
+        send(b"\x03\x00C")
+        send(b"D", 0.2)
+        received = os.read(self.master, 4096)
+        send(b"cRS\x01")
+        os.close(self.master)
+        output = device.communicate()[0]
+
+        self.assertEqual([events for _, events in lines(output, "events")], [3])
+        self.assertEqual([capture for _, capture in lines(output, "capture")], [1, 0])
+        self.assertEqual([freeze for _, freeze in lines(output, "freeze")], [1, 0])    # command, resumed
+        self.assertEqual([mode for _, mode in lines(output, "mode")], [1])
+        packet_types = [packet_type for packet_type, _ in Packet.Reader().feed(received)]
+        self.assertEqual(packet_types.count(Packet.TYPE_TRACE), 2)
+
+
+if __name__ == "__main__":
+    with tempfile.TemporaryDirectory() as directory:
+        SyncPty.executable = build(directory)
+        unittest.main()
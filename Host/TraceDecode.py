@@ -0,0 +1,123 @@
+"""
+    TraceDecode.py
+    Author: agent
+
+    Decodes trace dumps (see Trace.c) and prints the records of all rings as a
+    single timeline, e.g.:
+
+    stty -F /dev/ttyUSB0 250000 raw
+    python3 Host/TraceDecode.py --dump /dev/ttyUSB0
+
+    --dump sends the 'D' command and exits after the first complete dump.
+    Otherwise the input is read until the end of the file (or Ctrl+C) and every
+    dump is printed.
+
+    Each ring has its own 16-bit timebase (see Trace.c): ADC ISR records are in
+    Timer 2 ticks (16 us) that wrap every 1.05 s and main loop records are in
+    4.096 ms ticks that wrap every 268 s.  Each record is unwrapped relative to
+    its ring's freeze time, which is later than every record, and printed in
+    milliseconds before the freeze.  Main loop times are therefore resolved to
+    4.096 ms and records more than 268 s before the freeze are shown at the
+    wrong time.  Records with equal times keep their ring order (ADC ISR
+    first) and their order within the ring.
+"""
+
+import argparse
+import struct
+import sys
+
+import Packet
+
+TICK_MS = [0.016, 4.096]     # per ring
+HEADER_LENGTH = 5
+RECORD_LENGTH = 4
+NUMBER_OF_RINGS = 2
+
+RINGS = ["ADC ISR", "main"]
+FREEZE_REASONS = ["NONE", "COMMAND", "UART_OVERRUN", "GAIN_CHATTER"]
+PREAMP_GAINS = ["GAIN_1", "GAIN_4", "GAIN_16", "GAIN_25", "GAIN_64", "GAIN_100", "GAIN_256", "GAIN_1024", "GAIN_INVALID"]
+BATTERY_TIERS = ["FULL", "REDUCED", "ECONOMY", "CRITICAL"]
+SYNC_MODES = ["OFF", "LEADER", "FOLLOWER"]
+
+EVENTS = [  # name and argument names (None to print argument as a number)
+    ("ADC_ISR_ENTRY", None),
+    ("ADC_ISR_EXIT", None),
+    ("PREAMP_GAIN", PREAMP_GAINS),
+    ("UART_RX_OVERRUN", None),
+    ("UART_FRAMING_ERROR", None),
+    ("BATTERY_TIER", BATTERY_TIERS),
+    ("CHARGING", None),
+    ("SYNC_MODE", SYNC_MODES),
+]
+
+
+def name(names, index):
+    return names[index] if index < len(names) else str(index)
+
+
+def parse(payload):
+    """Returns the ring, freeze reason, freeze time and records of a dump packet."""
+    ring, reason, freeze_time, count = struct.unpack_from("<BBHB", payload)
+    if len(payload) != HEADER_LENGTH + count * RECORD_LENGTH:
+        raise ValueError("trace packet length does not match record count")
+    records = [struct.unpack_from("<HBB", payload, HEADER_LENGTH + i * RECORD_LENGTH) for i in range(count)]
+    return ring, reason, freeze_time, records
+
+
+def timeline(rings, reason):
+    """Returns the lines of the merged timeline of a dump, rings maps ring to freeze time and records."""
+    entries = []
+    for ring in sorted(rings):
+        freeze_time, records = rings[ring]
+        tick_ms = TICK_MS[ring] if ring < len(TICK_MS) else TICK_MS[0]
+        for index, (time, event, argument) in enumerate(records):
+            age = (freeze_time - time) & 0xFFFF
+            entries.append((-age * tick_ms, ring, index, event, argument))
+    entries.sort()
+    lines = ["Trace frozen by %s, %d records" % (name(FREEZE_REASONS, reason), len(entries))]
+    for milliseconds, ring, _, event, argument in entries:
+        event_name, argument_names = EVENTS[event] if event < len(EVENTS) else (str(event), None)
+        argument_text = name(argument_names, argument) if argument_names else str(argument)
+        lines.append("%10.3f ms  %-8s %-20s %s" % (milliseconds, RINGS[ring] if ring < len(RINGS) else ring,
+                                                  event_name, argument_text))
+    return lines
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode DressCode trace dumps to a timeline.")
+    parser.add_argument("input", help="recorded UART 2 stream or serial port, - for stdin")
+    parser.add_argument("--dump", action="store_true", help="send 'D' to the serial port and exit after one dump")
+    arguments = parser.parse_args()
+
+    if arguments.input == "-":
+        stream = sys.stdin.buffer
+    else:
+        stream = open(arguments.input, "r+b" if arguments.dump else "rb", buffering=0)
+    if arguments.dump:
+        stream.write(b"D")
+
+    rings = {}
+    dump_reason = None
+    try:
+        for packet_type, payload in Packet.read(stream):
+            if packet_type != Packet.TYPE_TRACE:
+                continue
+            ring, reason, freeze_time, records = parse(payload)
+            if rings and (ring <= max(rings) or reason != dump_reason):
+                print("\n".join(timeline(rings, dump_reason)) + "\n")  # incomplete dump
+                rings = {}
+            dump_reason = reason
+            rings[ring] = (freeze_time, records)
+            if len(rings) == NUMBER_OF_RINGS:
+                print("\n".join(timeline(rings, dump_reason)) + "\n")
+                rings = {}
+                if arguments.dump:
+                    break
+    except KeyboardInterrupt:
+        pass
+    if rings:
+        print("\n".join(timeline(rings, dump_reason)))
+
+
+if __name__ == "__main__":
+    main()